@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <stdexcept>
 
+#include "Trace.h"
+
 #include <GLFW/glfw3.h> // Will drag system OpenGL headers
 
 static void SetDarkThemeColors()
@@ -139,7 +141,7 @@ static void glfw_error_callback(int error, const char *description)
 
 App *App::s_Instance = nullptr;
 
-App::App()
+App::App(const AppOptions &options)
 {
 	assert(s_Instance == nullptr && "App already exists!");
 	s_Instance = this;
@@ -205,15 +207,48 @@ App::App()
 #endif
 	m_randomName = "user_" + std::to_string(pid);
 	m_client = std::make_unique<WebRTCClient>(m_randomName);
-	
-	// FLOW STEP 1: Set up callback for when someone wants to connect to us
-	// This gets called when we receive a "connection-request" message
-	m_client->onConnectionRequest = [this](const std::string& fromClientId, const std::string& fromClientName) {
-		// Store who's asking and show the popup to user
-		m_requestingClientId = fromClientId;
-		m_requestingClientName = fromClientName;
-		m_showConnectionPopup = true; // This triggers the "Accept/Reject" popup
-	};
+	m_client_window = std::make_unique<ClientWindow>(*m_client);
+	m_client->setTransportProfile(options.transport);
+	if (options.impairment)
+	{
+		auto relay = std::make_shared<ImpairmentRelay>(*options.impairment);
+		if (!relay->start())
+			throw std::runtime_error("Failed to start impairment relay");
+		m_client->setImpairmentRelay(relay);
+	}
+
+	// FLOW STEP 1: Incoming "connection-request" messages are queued by the client.
+	// The policy decides which ones are accepted without the popup.
+	m_client->setAutoAcceptPolicy(options.auto_accept);
+	m_client->setMaxConcurrentHandshakes(options.max_handshakes);
+	m_client->setMeshSignaling(options.mesh_signaling);
+	m_client->setHibernateAfter(options.hibernate_after);
+
+	for (const auto &file : options.media_files)
+	{
+		if (!m_client->startMediaStream(file, options.video_fps))
+			throw std::runtime_error("Failed to load media file " + file);
+	}
+
+	if (!options.record_file.empty() && !m_client->startRecording(options.record_file))
+		throw std::runtime_error("Failed to open session trace " + options.record_file);
+
+	// Replay drives the client from a recorded trace; there is no server to talk to
+	if (!options.replay_file.empty())
+	{
+		if (!m_client->startReplay(options.replay_file, options.replay_speed))
+			throw std::runtime_error("Failed to load session trace " + options.replay_file);
+		m_randomName = m_client->getClientId();
+		return;
+	}
+
+	// LAN mode: peers find each other by multicast beacon, no server involved
+	if (options.lan)
+	{
+		if (!m_client->startLanDiscovery())
+			throw std::runtime_error("Failed to start LAN discovery");
+		return;
+	}
 
 	std::cout << "Connecting to signaling server..." << std::endl;
 	if (!m_client->connectToSignalingServer("ws://localhost:8080/ws"))
@@ -238,10 +273,16 @@ void App::run()
 {
 	ImGuiIO &io = ImGui::GetIO();
 	(void)io;
+	Trace::setThreadName("Main");
 	// Main loop
 	while (!glfwWindowShouldClose(m_window))
 	{
-		glfwPollEvents();
+		TRACE_SCOPE("Frame");
+		{
+			TRACE_SCOPE("PollEvents");
+			glfwPollEvents();
+		}
+		m_client->update();
 		if (glfwGetWindowAttrib(m_window, GLFW_ICONIFIED) != 0)
 		{
 			ImGui_ImplGlfw_Sleep(10);
@@ -249,9 +290,15 @@ void App::run()
 		}
 
 		// Start the Dear ImGui frame
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+		{
+			TRACE_SCOPE("NewFrame");
+			ImGui_ImplOpenGL3_NewFrame();
+			ImGui_ImplGlfw_NewFrame();
+			ImGui::NewFrame();
+		}
+
+		// Everything up to ImGui::Render() is widget building
+		int64_t build_ui_start = Trace::nowMicros();
 
 		ImGui::DockSpaceOverViewport(0, ImGui::GetMainViewport());
 
@@ -279,6 +326,23 @@ void App::run()
 			ImGui::Text("counter = %d", counter);
 
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+
+			// Frame/network timeline capture
+			bool tracing = Trace::isEnabled();
+			if (ImGui::Checkbox("Record trace", &tracing))
+			{
+				Trace::setEnabled(tracing);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Dump trace"))
+			{
+				if (Trace::dump("trace.json"))
+					std::cout << "Trace written to trace.json (" << Trace::eventCount() << " events)" << std::endl;
+				else
+					std::cout << "Failed to write trace.json" << std::endl;
+			}
+			ImGui::SameLine();
+			ImGui::Text("%zu events (%zu dropped)", Trace::eventCount(), Trace::droppedCount());
 			ImGui::End();
 		}
 
@@ -292,181 +356,41 @@ void App::run()
 			ImGui::End();
 		}
 
-		{
-			ImGui::Begin("WebRTC Client");
-			ImGui::Text("Your ID: %s", m_randomName.c_str());
-			ImGui::SameLine();
-			if (ImGui::Button("Copy##CopyID"))
-			{
-				ImGui::SetClipboardText(m_randomName.c_str());
-			}
-			ImGui::Separator();
-			
-			// Active users section
-			auto connected_peers = m_client->getConnectedPeerIds();
-			ImGui::Text("Online Users (%zu) | Connected (%zu):", m_client->getConnectedClients().size(), connected_peers.size());
-			
-			if (!connected_peers.empty()) {
-				ImGui::SameLine();
-				ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "• %zu active connections", connected_peers.size());
-			}
-			
-			ImGui::BeginChild("ActiveUsers", ImVec2(0, 120), true);
-			for (const auto& clientId : m_client->getConnectedClients())
-			{
-				bool isConnected = m_client->isConnectedToPeer(clientId);
-				
-				// Show connection status with color coding
-				if (isConnected)
-				{
-					ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "★ %s (Connected)", clientId.c_str());
-				}
-				else
-				{
-					ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "• %s (Online)", clientId.c_str());
-				}
-				
-				ImGui::SameLine();
-				if (ImGui::SmallButton(("Copy##" + clientId).c_str()))
-				{
-					ImGui::SetClipboardText(clientId.c_str());
-				}
-				
-				if (!isConnected)
-				{
-					ImGui::SameLine();
-					if (ImGui::SmallButton(("Connect##" + clientId).c_str()))
-					{
-						// FLOW STEP 2: User clicks "Connect" - we send a connection request
-						// This sends JSON: {"type":"connection-request","from":"us","to":"them"}
-						m_client->sendConnectionRequest(clientId);
-					}
-				}
-				else
-				{
-					ImGui::SameLine();
-					ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "✓ Connected");
-					ImGui::SameLine();
-					ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.2f, 0.2f, 1.0f));
-					ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.9f, 0.3f, 0.3f, 1.0f));
-					ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.7f, 0.1f, 0.1f, 1.0f));
-					if (ImGui::SmallButton(("Disconnect##" + clientId).c_str()))
-					{
-						m_client->disconnectFromPeer(clientId);
-					}
-					ImGui::PopStyleColor(3);
-				}
-			}
-			if (m_client->getConnectedClients().empty())
-			{
-				ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "No other users online");
-			}
-			ImGui::EndChild();
-			
-			ImGui::Separator();
-			
-			// Manual connection section
-			ImGui::Text("Manual Connect:");
-			static char targetClientId[256] = {};
-			ImGui::InputText("Client ID", targetClientId, 256);
-			ImGui::SameLine();
-			if (ImGui::Button("Request Connection") && strlen(targetClientId) > 0)
-			{
-				m_client->sendConnectionRequest(targetClientId);
-			}
-			
-			ImGui::Separator();
-			
-			// Message section
-			ImGui::Text("Send Message:");
-			static char buffer[1024] = {};
-			ImGui::InputText("Message", buffer, 1024);
-			
-			// Send options
-			if (ImGui::Button("Broadcast to All") && strlen(buffer) > 0)
-			{
-				m_client->sendMessage(buffer); // Empty peer_id = broadcast
-				memset(buffer, 0, sizeof(buffer));
-			}
-			
-			// Send to specific peers
-			auto connected_peers_list = m_client->getConnectedPeerIds();
-			if (!connected_peers_list.empty()) {
-				ImGui::SameLine();
-				ImGui::Text("or send to:");
-				for (const auto& peer_id : connected_peers_list) {
-					ImGui::SameLine();
-					if (ImGui::SmallButton((peer_id + "##send").c_str()) && strlen(buffer) > 0) {
-						m_client->sendMessage(buffer, peer_id);
-						memset(buffer, 0, sizeof(buffer));
-					}
-				}
-			}
+		m_client_window->draw();
 
-			ImGui::Separator();
-			ImGui::Text("Message History:");
-			ImGui::BeginChild("MessageHistory", ImVec2(0, 180), true);
-			for (const auto &msg : m_client->getMessageHistory())
-			{
-				ImGui::TextWrapped("%s", msg.c_str());
-			}
-			ImGui::EndChild();
-			ImGui::End();
-		}
-		
-		// Connection request popup
-		if (m_showConnectionPopup)
+		if (Trace::isEnabled())
+			Trace::record("BuildUI", build_ui_start, Trace::nowMicros());
+
+		// Rendering
 		{
-			ImGui::OpenPopup("Connection Request");
+			TRACE_SCOPE("ImGui::Render");
+			ImGui::Render();
 		}
-		
-		if (ImGui::BeginPopupModal("Connection Request", &m_showConnectionPopup, ImGuiWindowFlags_AlwaysAutoResize))
 		{
-			ImGui::Text("User '%s' wants to connect with you.", m_requestingClientName.c_str());
-			ImGui::Text("Do you want to accept this connection?");
-			ImGui::Separator();
-			
-			if (ImGui::Button("Accept"))
-			{
-				// FLOW STEP 3: User accepts connection request
-				// Sends JSON: {"type":"connection-response","data":{"accepted":true}}
-				m_client->sendConnectionResponse(m_requestingClientId, true);
-				m_showConnectionPopup = false;
-				ImGui::CloseCurrentPopup();
-			}
-			ImGui::SameLine();
-			if (ImGui::Button("Reject"))
-			{
-				// FLOW STEP 3 (Alternative): User rejects connection request  
-				// Sends JSON: {"type":"connection-response","data":{"accepted":false}}
-				m_client->sendConnectionResponse(m_requestingClientId, false);
-				m_showConnectionPopup = false;
-				ImGui::CloseCurrentPopup();
-			}
-			
-			ImGui::EndPopup();
+			TRACE_SCOPE("RenderDrawData");
+			int display_w, display_h;
+			glfwGetFramebufferSize(m_window, &display_w, &display_h);
+			glViewport(0, 0, display_w, display_h);
+			glClearColor(m_clear_color.x * m_clear_color.w, m_clear_color.y * m_clear_color.w, m_clear_color.z * m_clear_color.w, m_clear_color.w);
+			glClear(GL_COLOR_BUFFER_BIT);
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		// Rendering
-		ImGui::Render();
-		int display_w, display_h;
-		glfwGetFramebufferSize(m_window, &display_w, &display_h);
-		glViewport(0, 0, display_w, display_h);
-		glClearColor(m_clear_color.x * m_clear_color.w, m_clear_color.y * m_clear_color.w, m_clear_color.z * m_clear_color.w, m_clear_color.w);
-		glClear(GL_COLOR_BUFFER_BIT);
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
 		// Update and Render additional Platform Windows
 		// (Platform functions may change the current OpenGL context, so we save/restore it to make it easier to paste this code elsewhere.
 		//  For this specific demo app we could also call glfwMakeContextCurrent(m_window) directly)
 		if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
 		{
+			TRACE_SCOPE("PlatformWindows");
 			GLFWwindow *backup_current_context = glfwGetCurrentContext();
 			ImGui::UpdatePlatformWindows();
 			ImGui::RenderPlatformWindowsDefault();
 			glfwMakeContextCurrent(backup_current_context);
 		}
 
-		glfwSwapBuffers(m_window);
+		{
+			TRACE_SCOPE("SwapBuffers");
+			glfwSwapBuffers(m_window);
+		}
 	}
 }
\ No newline at end of file
@@ -3,16 +3,40 @@
 #include <imgui.h>
 
 
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "Client.h"
+#include "ClientWindow.h"
+#include "HandshakeScheduler.h"
+#include "ImpairmentRelay.h"
+#include "TransportProfile.h"
+
+// Command-line options (see main.cpp)
+struct AppOptions
+{
+	TransportProfile transport = *TransportProfile::builtin("wan");
+	std::optional<ImpairmentConfig> impairment; // --impair: route peer traffic through a lossy local relay
+	AutoAcceptPolicy auto_accept = AutoAcceptPolicy::Manual;
+	size_t max_handshakes = 8; // Concurrent WebRTC negotiations
+	std::vector<std::string> media_files; // --stream: clips sent to every peer
+	double video_fps = 30.0;			  // Frame rate of raw H.264 clips
+	bool mesh_signaling = true;			  // Relay signaling over data channels when possible
+	std::string record_file;			  // --record: capture the session to a trace file
+	std::string replay_file;			  // --replay: play a recorded session instead of connecting
+	double replay_speed = 1.0;			  // 0 = as fast as possible
+	std::chrono::seconds hibernate_after{0}; // Close idle peers until they are needed again (0 = never)
+	bool lan = false;					  // --lan: multicast discovery instead of the signaling server
+};
 
 struct GLFWwindow;
 class App
 {
 public:
-	App();
+	App(const AppOptions& options = AppOptions());
 	~App();
 
 	void run();
@@ -30,9 +54,5 @@ private:
 
 	std::string m_randomName;
 	std::unique_ptr<WebRTCClient> m_client;
-	
-	// Connection request popup state
-	bool m_showConnectionPopup = false;
-	std::string m_requestingClientName;
-	std::string m_requestingClientId;
+	std::unique_ptr<ClientWindow> m_client_window;
 };
\ No newline at end of file
@@ -1,26 +1,67 @@
 #include "Client.h"
+#include "JsonFields.h"
+#include "SignalingParser.h"
+#include "MessageCoalescer.h"
+#include "Trace.h"
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+
 using json = nlohmann::json;
 
-WebRTCClient::WebRTCClient(const std::string &id) : client_id(id)
+WebRTCClient::WebRTCClient(const std::string &id) : client_id(id), transport(*TransportProfile::builtin("wan"))
 {
 	// Constructor now just stores the client ID
 	// Peer connections will be created on-demand
+	handshakes.setLocalId(id);
+}
+
+WebRTCClient::~WebRTCClient()
+{
+	{
+		std::lock_guard<std::mutex> lock(delivery_mutex);
+		coalesce_stopping = true;
+	}
+	coalesce_wake.notify_all();
+	if (coalesce_thread.joinable())
+	{
+		coalesce_thread.join();
+	}
+
+	// The discovery thread calls back into us; stop it before any member goes away
+	if (lan)
+	{
+		lan->stop();
+	}
+}
+
+void WebRTCClient::setTransportProfile(const TransportProfile &profile)
+{
+	transport = profile;
+	transport.applyGlobalSettings();
+	std::cout << "Using transport profile '" << transport.name << "' (" << transport.ice_servers.size() << " ICE servers)" << std::endl;
 }
 
-void WebRTCClient::setupPeerConnection(const std::string &peer_id)
+std::shared_ptr<rtc::PeerConnection> WebRTCClient::setupPeerConnection(const std::string &peer_id)
 {
 	// Create new peer connection
-	rtc::Configuration config;
-	config.iceServers.emplace_back("stun:stun.l.google.com:19302");
+	rtc::Configuration config = transport.toConfiguration();
 
-	PeerConnection &peer = peer_connections[peer_id];
-	peer.pc = std::make_shared<rtc::PeerConnection>(config);
+	auto pc = std::make_shared<rtc::PeerConnection>(config);
+
+	// A closed connection (hibernated, timed out, replaced) keeps reporting
+	// states after a newer one took its place; those must not touch the new one
+	const rtc::PeerConnection *self = pc.get();
 
 	// Handle connection state changes
-	peer.pc->onStateChange([this, peer_id](rtc::PeerConnection::State state)
+	pc->onStateChange([this, peer_id, self](rtc::PeerConnection::State state)
 						   {
+			TRACE_SCOPE("pc.onStateChange");
+			if (!isCurrentConnection(peer_id, self))
+			{
+				std::cout << "Ignoring state change of a replaced connection to " << peer_id << std::endl;
+				return;
+			}
 			// FLOW STEP 11: Monitor WebRTC connection state
 			std::cout << "Connection to " << peer_id << " state: ";
 			switch (state) {
@@ -33,27 +74,58 @@ void WebRTCClient::setupPeerConnection(const std::string &peer_id)
 				case rtc::PeerConnection::State::Connected:
 					// FLOW SUCCESS: Direct peer-to-peer connection established!
 					std::cout << "Connected!" << std::endl;
-					peer_connections[peer_id].connected = true;
-					peer_connections[peer_id].negotiation_in_progress = false;
+					updateCurrentPeer(peer_id, self, [](PeerConnection &peer)
+									  {
+							peer.connected = true;
+							peer.negotiation_in_progress = false; });
+					{
+						std::lock_guard<std::mutex> lock(handshake_mutex);
+						handshakes.onConnected(peer_id, HandshakeScheduler::Clock::now());
+					}
 					// Now we can send messages directly without signaling server
 					break;
 				case rtc::PeerConnection::State::Disconnected:
 					std::cout << "Disconnected!" << std::endl;
-					peer_connections[peer_id].connected = false;
+					updateCurrentPeer(peer_id, self, [](PeerConnection &peer)
+									  { peer.connected = false; });
 					break;
 				case rtc::PeerConnection::State::Failed:
 					std::cout << "Failed!" << std::endl;
-					peer_connections[peer_id].connected = false;
+					updateCurrentPeer(peer_id, self, [](PeerConnection &peer)
+									  { peer.connected = false; });
+					{
+						std::lock_guard<std::mutex> lock(handshake_mutex);
+						handshakes.onFailed(peer_id, HandshakeScheduler::Clock::now());
+					}
 					break;
 				case rtc::PeerConnection::State::Closed:
 					std::cout << "Closed!" << std::endl;
-					peer_connections.erase(peer_id);
+					{
+						// Released after the lock: the last reference may go with it
+						PeerConnection removed;
+						std::lock_guard<std::mutex> lock(peers_mutex);
+						auto it = peer_connections.find(peer_id);
+						if (it != peer_connections.end() && it->second.pc.get() == self)
+						{
+							removed = std::move(it->second);
+							peer_connections.erase(it);
+						}
+					}
+					{
+						std::lock_guard<std::mutex> lock(handshake_mutex);
+						handshakes.onFailed(peer_id, HandshakeScheduler::Clock::now());
+					}
 					break;
 			} });
 
 	// Add ICE connection state monitoring
-	peer.pc->onGatheringStateChange([peer_id](rtc::PeerConnection::GatheringState state)
+	pc->onGatheringStateChange([this, peer_id, self](rtc::PeerConnection::GatheringState state)
 									{
+			TRACE_SCOPE("pc.onGatheringStateChange");
+			if (!isCurrentConnection(peer_id, self))
+			{
+				return;
+			}
 			std::cout << "ICE gathering for " << peer_id << ": ";
 			switch (state) {
 				case rtc::PeerConnection::GatheringState::New:
@@ -61,15 +133,27 @@ void WebRTCClient::setupPeerConnection(const std::string &peer_id)
 					break;
 				case rtc::PeerConnection::GatheringState::InProgress:
 					std::cout << "In Progress" << std::endl;
+					updateCurrentPeer(peer_id, self, [](PeerConnection &peer)
+									  { peer.gathering_started = std::chrono::steady_clock::now(); });
 					break;
 				case rtc::PeerConnection::GatheringState::Complete:
-					std::cout << "Complete" << std::endl;
+				{
+					// Gathering time is what the transport profile mostly affects (STUN round trips)
+					double gathering_ms = -1.0;
+					updateCurrentPeer(peer_id, self, [&gathering_ms](PeerConnection &peer)
+									  {
+							peer.gathering_ms = std::chrono::duration<double, std::milli>(
+								std::chrono::steady_clock::now() - peer.gathering_started).count();
+							gathering_ms = peer.gathering_ms; });
+					std::cout << "Complete (" << gathering_ms << " ms, profile '" << transport.name << "')" << std::endl;
 					break;
+				}
 			} });
 
 	// Handle local description (offer/answer)
-	peer.pc->onLocalDescription([this, peer_id](rtc::Description desc)
+	pc->onLocalDescription([this, peer_id](rtc::Description desc)
 								{
+			TRACE_SCOPE("pc.onLocalDescription");
 			// FLOW STEP 6: WebRTC generates SDP offer/answer - send it via signaling server
 			std::cout << "Sending " << desc.typeString() << " to " << peer_id << std::endl;
 			
@@ -81,13 +165,12 @@ void WebRTCClient::setupPeerConnection(const std::string &peer_id)
 				{"data", std::string(desc)}  // The actual SDP data
 			};
 			
-			if (signaling_ws) {
-				signaling_ws->send(message.dump());
-			} });
+			sendSignal(message); });
 
 	// Handle local ICE candidates
-	peer.pc->onLocalCandidate([this, peer_id](rtc::Candidate candidate)
+	pc->onLocalCandidate([this, peer_id](rtc::Candidate candidate)
 							  {
+			TRACE_SCOPE("pc.onLocalCandidate");
 			std::cout << "Sending ICE candidate to " << peer_id << std::endl;
 			
 			json message = {
@@ -97,370 +180,2021 @@ void WebRTCClient::setupPeerConnection(const std::string &peer_id)
 				{"data", std::string(candidate)}
 			};
 			
-			if (signaling_ws) {
-				signaling_ws->send(message.dump());
-			} });
+			sendSignal(message); });
+
+	// Handle incoming media tracks
+	pc->onTrack([this, peer_id, self](std::shared_ptr<rtc::Track> track)
+					 {
+			TRACE_SCOPE("pc.onTrack");
+			std::cout << "Receiving media track '" << track->mid() << "' from " << peer_id << std::endl;
+			// Sends receiver reports back so the sender's RTCP handlers have something to work with
+			track->setMediaHandler(std::make_shared<rtc::RtcpReceivingSession>());
+			track->onMessage([this](rtc::message_variant message)
+							 {
+					if (std::holds_alternative<rtc::binary>(message)) {
+						media_packets_received.fetch_add(1, std::memory_order_relaxed);
+					} });
+			updateCurrentPeer(peer_id, self, [&track](PeerConnection &peer)
+							  { peer.remote_tracks.push_back(track); }); });
 
 	// Handle incoming data channels
-	peer.pc->onDataChannel([this, peer_id](std::shared_ptr<rtc::DataChannel> channel)
+	pc->onDataChannel([this, peer_id, self](std::shared_ptr<rtc::DataChannel> channel)
 						   {
+			TRACE_SCOPE("pc.onDataChannel");
+			if (!isCurrentConnection(peer_id, self))
+			{
+				return;
+			}
 			std::cout << "Received data channel from " << peer_id << ": " << channel->label() << std::endl;
 			setupDataChannel(peer_id, channel); });
+
+	// In the map once the callbacks are set; a connection it replaces keeps running until closed
+	std::shared_ptr<rtc::PeerConnection> installed = pc;
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	peer_connections[peer_id].pc.swap(pc); // The replaced one is released after the lock
+	return installed;
 }
 
 void WebRTCClient::setupDataChannel(const std::string &peer_id, std::shared_ptr<rtc::DataChannel> channel)
 {
-	auto &peer = peer_connections[peer_id];
-	peer.data_channel = channel;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		auto it = peer_connections.find(peer_id);
+		if (it != peer_connections.end())
+		{
+			it->second.data_channel = channel;
+		}
+	}
 
 	channel->onOpen([this, peer_id]()
-					{ std::cout << "Data channel to " << peer_id << " opened! You can now chat!" << std::endl; });
+					{
+			TRACE_SCOPE("dc.onOpen");
+			handleChannelOpen(peer_id); });
 
 	channel->onMessage([this, peer_id](rtc::message_variant message)
 					   {
+			TRACE_SCOPE("dc.onMessage");
 			if (std::holds_alternative<std::string>(message)) {
-				std::string msg = std::get<std::string>(message);
-				std::string formatted_msg = "[" + peer_id + "] " + msg;
-				message_history.push_back(formatted_msg);
-				std::cout << "received from " << peer_id << ": " << msg << std::endl;
+				handleChannelMessage(peer_id, std::get<std::string>(message));
 			} });
 
 	channel->onClosed([this, peer_id]()
 					  { 
-			std::cout << "Data channel to " << peer_id << " closed" << std::endl; 
-			if (peer_connections.find(peer_id) != peer_connections.end()) {
-				peer_connections[peer_id].connected = false;
-			} });
+			TRACE_SCOPE("dc.onClosed");
+			handleChannelClosed(peer_id); });
 }
 
-bool WebRTCClient::connectToSignalingServer(const std::string &url)
+void WebRTCClient::handleChannelOpen(const std::string &peer_id)
 {
-	try
-	{
-		signaling_ws = std::make_shared<rtc::WebSocket>();
-
-		signaling_ws->onOpen([this]()
-							 {
-                std::cout << "Connected to signaling server" << std::endl;
-                
-                // Join the server
-                json join_message = {
-                    {"type", "join"},
-                    {"from", client_id}
-                };
-                signaling_ws->send(join_message.dump()); });
-
-		signaling_ws->onMessage([this](rtc::message_variant message)
-								{
-                if (std::holds_alternative<std::string>(message)) {
-                    handleSignalingMessage(std::get<std::string>(message));
-                } });
-
-		signaling_ws->onClosed([this]()
-							   { std::cout << "Signaling server connection closed" << std::endl; });
+	recorder.record(SessionEventKind::ChannelOpen, peer_id, {});
+	std::cout << "Data channel to " << peer_id << " opened! You can now chat!" << std::endl;
 
-		signaling_ws->onError([this](std::string error)
-							  { std::cout << "Signaling error: " << error << std::endl; });
-
-		signaling_ws->open(url);
+	// Tell the peer how far we got so it can resend whatever we missed.
+	// New messages are held back until the peer answers with its own resume.
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	peer_activity[peer_id] = std::chrono::steady_clock::now();
+	if (hibernated_peers.erase(peer_id))
+	{
+		hibernation_stats.resumes++;
+	}
+	auto &session = delivery_sessions[peer_id];
+	session.setLinkReady(false);
+	json resume = {
+		{"type", "resume"},
+		{"ack", session.takeAck()},
+		{"epoch", session.epoch()},
+		{"peer_epoch", session.peerEpoch()}
+	};
+	sendFrame(peer_id, resume.dump());
+}
 
-		// Wait for connection
-		std::this_thread::sleep_for(std::chrono::seconds(1));
-		return true;
+void WebRTCClient::handleChannelClosed(const std::string &peer_id)
+{
+	recorder.record(SessionEventKind::ChannelClosed, peer_id, {});
+	std::cout << "Data channel to " << peer_id << " closed" << std::endl;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		auto it = peer_connections.find(peer_id);
+		if (it != peer_connections.end())
+		{
+			it->second.connected = false;
+		}
 	}
-	catch (const std::exception &e)
+
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	auto it = delivery_sessions.find(peer_id);
+	if (it != delivery_sessions.end())
 	{
-		std::cout << "Failed to connect to signaling server: " << e.what() << std::endl;
-		return false;
+		it->second.setLinkReady(false);
 	}
 }
 
-void WebRTCClient::handleSignalingMessage(const std::string &message)
+void WebRTCClient::handleChannelMessage(const std::string &peer_id, const std::string &message)
 {
-	std::cout << "Signaling message received: " << message << std::endl;
+	TRACE_SCOPE("handleChannelMessage");
+	recorder.record(SessionEventKind::ChannelMessage, peer_id, message);
+	json frame = json::parse(message, nullptr, false);
+	if (frame.is_discarded() || !frame.is_object() || !frame.contains("type"))
+	{
+		// Plain text from a peer that does not speak the delivery protocol
+		addHistoryLine({"[" + peer_id + "] " + message, -1.0, 0, HistorySync::wallMicros()});
+		std::cout << "received from " << peer_id << ": " << message << std::endl;
+		return;
+	}
 
+	std::vector<std::string> signals;
 	try
 	{
-		json msg = json::parse(message);
-		std::string type = msg["type"];
+		std::lock_guard<std::mutex> lock(delivery_mutex);
+		auto &session = delivery_sessions[peer_id];
 
-		if (type == "offer")
+		if (isString(frame, "type") && frame["type"] == "batch")
 		{
-			// FLOW STEP 7: Receive WebRTC offer from the requester
-			std::string from_peer_id = msg["from"];
-			std::string sdp = msg["data"];
-
-			std::cout << "Received offer from " << from_peer_id << ", creating answer..." << std::endl;
-
-			// Check if we already have a connection in progress or established
-			auto it = peer_connections.find(from_peer_id);
-			if (it != peer_connections.end() && (it->second.connected || it->second.negotiation_in_progress))
+			// Coalesced by the sender - unpack in order
+			if (!isArray(frame, "frames"))
 			{
-				std::cout << "Ignoring offer from " << from_peer_id << " - connection already exists or in progress" << std::endl;
+				std::cout << "Malformed frame from " << peer_id << ": batch without frames" << std::endl;
 				return;
 			}
-
-			// Set up peer connection for this peer if not exists
-			if (it == peer_connections.end())
+			for (const auto &inner : frame["frames"])
 			{
-				setupPeerConnection(from_peer_id); // Sets up callbacks
+				handleChannelFrame(peer_id, session, inner, 0); // History sync frames are never batched
 			}
-
-			auto &peer = peer_connections[from_peer_id];
-			peer.negotiation_in_progress = true;
-
-			// FLOW STEP 8: Set their offer as remote description, create our answer
-			peer.pc->setRemoteDescription(rtc::Description(sdp, "offer"));
-			peer.pc->setLocalDescription(); // Triggers onLocalDescription with "answer"
 		}
-		else if (type == "answer")
+		else
+		{
+			handleChannelFrame(peer_id, session, frame, message.size());
+		}
+
+		if (session.ackDue(ReliableSession::Clock::now()))
 		{
-			// FLOW STEP 9: Original requester receives the answer
-			std::string from_peer_id = msg["from"];
-			std::string sdp = msg["data"];
+			json ack = {
+				{"type", "ack"},
+				{"ack", session.takeAck()}
+			};
+			sendFrame(peer_id, ack.dump());
+		}
 
-			std::cout << "Received answer from " << from_peer_id << std::endl;
+		signals.swap(inbound_signals);
+	}
+	catch (const json::exception &e)
+	{
+		std::cout << "Malformed frame from " << peer_id << ": " << e.what() << std::endl;
+	}
 
-			auto it = peer_connections.find(from_peer_id);
-			if (it != peer_connections.end())
-			{
-				// Set their answer as remote description - now both sides have SDP
-				it->second.pc->setRemoteDescription(rtc::Description(sdp, "answer"));
-				// WebRTC will now start ICE candidate exchange automatically
-			}
+	// Signaling may set descriptions, which can call straight back into sendSignal
+	for (auto &signal : signals)
+	{
+		handleSignalingMessage(std::move(signal));
+	}
+}
+
+void WebRTCClient::handleChannelFrame(const std::string &peer_id, ReliableSession &session, const json &frame, size_t wire_bytes)
+{
+	// Peers send these: each branch checks the fields it reads before reading them
+	if (!frame.is_object() || !isString(frame, "type"))
+	{
+		std::cout << "Malformed frame from " << peer_id << ": no type" << std::endl;
+		return;
+	}
+	std::string type = frame["type"];
+
+	if (type == "msg")
+	{
+		if (!isUnsigned(frame, "seq") || !isString(frame, "body") || (frame.contains("ack") && !isUnsigned(frame, "ack")))
+		{
+			std::cout << "Malformed msg frame from " << peer_id << std::endl;
+			return;
 		}
-		else if (type == "ice-candidate")
+
+		// Data frames piggyback the sender's cumulative ack
+		if (frame.contains("ack"))
 		{
-			// FLOW STEP 10: Exchange ICE candidates (happens multiple times)
-			std::string from_peer_id = msg["from"];
-			std::string candidate_str = msg["data"];
+			session.onAck(frame["ack"].get<uint64_t>());
+		}
 
-			std::cout << "Received ICE candidate from " << from_peer_id << std::endl;
+		if (session.onData(frame["seq"].get<uint64_t>()) == ReliableSession::ReceiveResult::Deliver)
+		{
+			std::string msg = frame["body"];
+			ChatMessage entry{"[" + peer_id + "] " + msg};
+			entry.ts_us = HistorySync::wallMicros();
 
-			auto it = peer_connections.find(from_peer_id);
-			if (it != peer_connections.end())
+			// Public messages join the shared history; one we already fetched through sync is not shown twice
+			if (isUnsigned(frame, "hid") && isInteger(frame, "hts"))
 			{
-				try
-				{
-					// Add their network path info so we can connect directly
-					it->second.pc->addRemoteCandidate(rtc::Candidate(candidate_str));
-				}
-				catch (const std::exception &e)
+				HistoryItem item{frame["hid"].get<uint64_t>(), frame["hts"].get<int64_t>(), peer_id, msg};
+				if (HistorySync::makeId(item.from, item.ts_us, item.body) == item.id)
 				{
-					std::cout << "Failed to add ICE candidate from " << from_peer_id << ": " << e.what() << std::endl;
+					entry.history_id = item.id;
+					if (!history.add(std::move(item)))
+					{
+						return;
+					}
 				}
 			}
+
+			// Sender timestamp mapped onto our clock via the probe's offset estimate
+			auto &latency = peer_latency[peer_id];
+			if (isInteger(frame, "ts") && latency.estimator.hasEstimate())
+			{
+				entry.latency_ms = latency.estimator.oneWayMs(frame["ts"].get<int64_t>(), LatencyEstimator::nowMicros());
+				latency.report.one_way.add(entry.latency_ms);
+			}
+
+			addHistoryLine(std::move(entry));
+			peer_activity[peer_id] = std::chrono::steady_clock::now();
+			std::cout << "received from " << peer_id << ": " << msg << std::endl;
 		}
-		else if (type == "client-list")
+	}
+	else if (type == "ping")
+	{
+		if (!isInteger(frame, "t0"))
 		{
-			std::cout << "Updated client list received" << std::endl;
+			return;
+		}
 
-			connected_clients.clear();
+		// Answer straight away; t1/t2 let the prober subtract our turnaround
+		int64_t received_us = LatencyEstimator::nowMicros();
+		json pong = {
+			{"type", "pong"},
+			{"t0", frame["t0"].get<int64_t>()},
+			{"t1", received_us},
+			{"t2", LatencyEstimator::nowMicros()}
+		};
+		sendFrame(peer_id, pong.dump());
+	}
+	else if (type == "pong")
+	{
+		if (!isInteger(frame, "t0") || !isInteger(frame, "t1") || !isInteger(frame, "t2"))
+		{
+			return;
+		}
 
-			if (msg["data"].contains("clients") && msg["data"]["clients"].is_array())
-			{
-				for (const auto &client : msg["data"]["clients"])
-				{
-					std::string client_str = client;
-					if (!client_str.empty() && client_str != client_id)
-					{ // Don't include self
-						connected_clients.push_back(client_str);
-					}
-				}
-			}
+		// t0 is our own ping time coming back; one from the future would pass as a zero-RTT sample and win the filter
+		int64_t t0 = frame["t0"].get<int64_t>();
+		int64_t t1 = frame["t1"].get<int64_t>();
+		int64_t t2 = frame["t2"].get<int64_t>();
+		int64_t t3 = LatencyEstimator::nowMicros();
+		if (t0 > t3 || t2 < t1)
+		{
+			return;
+		}
+		auto &latency = peer_latency[peer_id];
+		double rtt_ms = latency.estimator.addSample(t0, t1, t2, t3);
+		latency.report.rtt.add(rtt_ms);
+		latency.report.rtt_ms = latency.estimator.rttMs();
 
-			std::cout << "Active clients: " << connected_clients.size() << std::endl;
+		// The batching window follows the filtered RTT
+		auto coalescer = coalescers.find(peer_id);
+		if (coalescer != coalescers.end())
+		{
+			coalescer->second.setRtt(std::chrono::microseconds(static_cast<int64_t>(latency.report.rtt_ms * 1000.0)));
+		}
+		latency.report.offset_ms = latency.estimator.offsetMicros() / 1000.0;
+	}
+	else if (type == "ack")
+	{
+		if (isUnsigned(frame, "ack"))
+		{
+			session.onAck(frame["ack"].get<uint64_t>());
 		}
-		else if (type == "connection-request")
+	}
+	else if (type == "resume")
+	{
+		if (!isUnsigned(frame, "ack") || (frame.contains("epoch") && !isUnsigned(frame, "epoch")) ||
+			(frame.contains("peer_epoch") && !isUnsigned(frame, "peer_epoch")))
 		{
-			// FLOW STEP 2 (Receiving): Someone wants to connect to us
-			std::cout << "Received connection request" << std::endl;
+			std::cout << "Malformed resume frame from " << peer_id << std::endl;
+			return;
+		}
 
-			std::string from_client_id = msg["from"];
+		// Peer (re)opened the channel: drop what it already has, resend the rest.
+		// A new epoch means it forgot the session, and ours starts over too.
+		if (session.onResume(frame.value("epoch", uint64_t{0}), frame.value("peer_epoch", uint64_t{0}), frame["ack"].get<uint64_t>()))
+		{
+			std::cout << peer_id << " started a new session; resending what it had not acked into it" << std::endl;
+		}
+		retransmitUnacked(peer_id, session);
+		sendFrame(peer_id, makeNeighborsFrame());
 
-			// Trigger the callback that shows the "Accept/Reject" popup in App.cpp
-			if (onConnectionRequest)
-			{
-				onConnectionRequest(from_client_id, from_client_id);
-			}
+		// One side opens history reconciliation; in sync it costs a single small frame
+		if (client_id < peer_id)
+		{
+			history_rounds[peer_id] = {std::chrono::steady_clock::now(), false};
+			sendFrame(peer_id, history.begin());
 		}
-		else if (type == "connection-response")
+	}
+	else if (type == "sync" || type == "want" || type == "history")
+	{
+		std::vector<HistoryItem> learned;
+		bool settled = false;
+		std::vector<std::string> replies = history.onFrame(frame, wire_bytes, learned, settled);
+		for (const auto &reply : replies)
 		{
-			// FLOW STEP 4: We get response to our connection request
-			std::string from_client_id = msg["from"];
-			bool accepted = msg["data"]["accepted"];
+			sendFrame(peer_id, reply);
+		}
 
-			if (accepted)
+		// A round we opened is done once it settles straight away; anything else gets a checking round
+		auto round = history_rounds.find(peer_id);
+		if (round != history_rounds.end())
+		{
+			if (settled && !round->second.exchanged)
 			{
-				std::cout << "Connection accepted by " << from_client_id << std::endl;
-
-				// FLOW STEP 5: Since WE made the request, WE create the WebRTC offer
-				// This starts the actual peer-to-peer connection process
-				std::cout << "We initiated the request, so we create the offer to " << from_client_id << std::endl;
-				createOffer(from_client_id); // Creates data channel + WebRTC offer
+				history_rounds.erase(round);
 			}
 			else
 			{
-				std::cout << "Connection rejected by " << from_client_id << std::endl;
+				round->second.last_frame = std::chrono::steady_clock::now();
+				round->second.exchanged = true;
 			}
+		}
 
-			if (onConnectionResponse)
-			{
-				onConnectionResponse(from_client_id, accepted);
-			}
+		// Missed messages go where the sender's wall clock puts them
+		for (auto &item : learned)
+		{
+			addHistoryLine({"[" + item.from + "] " + item.body, -1.0, item.id, item.ts_us, true});
+		}
+
+		if (settled)
+		{
+			HistorySyncStats stats = history.stats();
+			std::cout << "History in sync with " << peer_id << ": " << stats.items << " messages (" << stats.history_bytes
+					  << " bytes), " << stats.bytes_sent + stats.bytes_received << " bytes of sync traffic so far" << std::endl;
 		}
 	}
-	catch (const json::exception &e)
+	else if (type == "signal")
 	{
-		std::cout << "JSON parsing error: " << e.what() << std::endl;
-	}
-}
-
-void WebRTCClient::createOffer(const std::string &peer_id)
-{
-	// FLOW STEP 5: Create WebRTC offer (called by the requester)
-	std::cout << "Creating offer for " << peer_id << "..." << std::endl;
+		// Only the peer on the other end of this channel may signal over it
+		if (!isObject(frame, "signal") || !isString(frame["signal"], "from") || frame["signal"]["from"] != peer_id)
+		{
+			std::cout << "Dropped signal frame from " << peer_id << " not signed as its sender" << std::endl;
+			return;
+		}
 
-	// Set up peer connection if not exists
-	if (peer_connections.find(peer_id) == peer_connections.end())
-	{
-		setupPeerConnection(peer_id); // Sets up WebRTC peer connection + callbacks
+		// Signaling message that skipped the server
+		signaling_routes.received_mesh++;
+		inbound_signals.push_back(frame["signal"].dump());
 	}
-
-	auto &peer = peer_connections[peer_id];
-	peer.is_initiator = true;
-	peer.negotiation_in_progress = true;
-
-	// Create data channel for chat messages (this will trigger offer creation)
-	peer.data_channel = peer.pc->createDataChannel("chat");
-	setupDataChannel(peer_id, peer.data_channel);
-
-	// FLOW STEP 6: Generate SDP offer - this triggers onLocalDescription callback
-	peer.pc->setLocalDescription(); // Async - callback sends offer to other peer
-}
-
-void WebRTCClient::sendMessage(const std::string &msg, const std::string &peer_id)
-{
-	std::string full_message = client_id + ": " + msg;
-
-	if (peer_id.empty())
+	else if (type == "relay")
 	{
-		// Broadcast to all connected peers
-		int sent_count = 0;
-		for (auto &[id, peer] : peer_connections)
+		if (!isString(frame, "to") || !isObject(frame, "signal") || !isString(frame["signal"], "from") ||
+			(frame.contains("origin") && !isString(frame, "origin")))
+		{
+			return;
+		}
+
+		// The relaying neighbor stamps who handed it the signal; the origin must be
+		// a peer that neighbor told us it is connected to. Without a stamp the
+		// sender of this channel is the origin.
+		std::string target = frame["to"];
+		std::string origin = frame.value("origin", peer_id);
+		bool stamped = origin != peer_id;
+		if (stamped)
 		{
-			if (peer.connected && peer.data_channel)
+			auto advertised = neighbor_peers.find(peer_id);
+			if (target != client_id || advertised == neighbor_peers.end() ||
+				std::find(advertised->second.begin(), advertised->second.end(), origin) == advertised->second.end())
 			{
-				peer.data_channel->send(full_message);
-				sent_count++;
+				std::cout << "Dropped relay from " << peer_id << " for " << origin << ", not one of its peers" << std::endl;
+				return;
 			}
 		}
-		if (sent_count > 0)
+		if (frame["signal"]["from"] != origin)
 		{
-			message_history.push_back("[You] " + msg);
-			std::cout << "Broadcast sent to " << sent_count << " peers: " << msg << std::endl;
+			std::cout << "Dropped relay from " << peer_id << " not signed as " << origin << std::endl;
+			return;
 		}
-		else
+
+		// A neighbor introducing itself to one of our peers through us
+		if (target == client_id)
+		{
+			signaling_routes.received_mesh++;
+			inbound_signals.push_back(frame["signal"].dump());
+		}
+		else if (canSignalDirectly(target))
+		{
+			json forward = {
+				{"type", "relay"},
+				{"to", target},
+				{"origin", origin},
+				{"signal", frame["signal"]}
+			};
+			std::string wire = forward.dump();
+			signaling_routes.forwarded++;
+			signaling_routes.mesh_bytes += wire.size();
+			sendFrame(target, wire);
+		}
+		else if (lan && lan->send(target, frame["signal"].dump()))
 		{
-			std::cout << "No connected peers to send message to!" << std::endl;
+			// Our neighbor list was stale, but the target is on the LAN
+			signaling_routes.lan++;
+		}
+		else if (signaling_ws)
+		{
+			// Our neighbor list was stale - let the server deliver it
+			std::string wire = frame["signal"].dump();
+			signaling_routes.websocket++;
+			signaling_routes.websocket_bytes += wire.size();
+			signaling_ws->send(wire);
 		}
 	}
-	else
+	else if (type == "hibernate")
 	{
-		// Send to specific peer
-		auto it = peer_connections.find(peer_id);
-		if (it != peer_connections.end() && it->second.connected && it->second.data_channel)
+		// The peer is closing our idle connection; the next send reconnects
+		hibernated_peers.insert(peer_id);
+		hibernation_stats.hibernations++;
+		std::cout << peer_id << " hibernated the idle connection" << std::endl;
+	}
+	else if (type == "neighbors")
+	{
+		if (!isArray(frame, "peers"))
 		{
-			it->second.data_channel->send(full_message);
-			message_history.push_back("[You -> " + peer_id + "] " + msg);
-			std::cout << "Sent to " << peer_id << ": " << msg << std::endl;
+			return;
 		}
-		else
+		auto &peers = neighbor_peers[peer_id];
+		peers.clear();
+		for (const auto &neighbor : frame["peers"])
 		{
-			std::cout << "Not connected to " << peer_id << "!" << std::endl;
+			if (neighbor.is_string() && neighbor != client_id)
+			{
+				peers.push_back(neighbor);
+			}
 		}
 	}
 }
 
-const std::vector<std::string> &WebRTCClient::getMessageHistory() const
+void WebRTCClient::sendFrame(const std::string &peer_id, const std::string &frame)
 {
-	return message_history;
-}
+	auto channel = openChannel(peer_id);
+	if (!channel)
+	{
+		return;
+	}
 
-const std::vector<std::string> &WebRTCClient::getConnectedClients() const
-{
-	return connected_clients;
+	// Anything still held by the coalescer goes first to keep frames in order
+	auto coalescer = coalescers.find(peer_id);
+	if (coalescer != coalescers.end() && coalescer->second.hasPending())
+	{
+		if (auto batch = coalescer->second.flush(MessageCoalescer::Clock::now(), true))
+		{
+			coalescing_stats.wire_messages++;
+			channel->send(*batch);
+		}
+	}
+
+	channel->send(frame);
 }
 
-std::vector<std::string> WebRTCClient::getConnectedPeerIds() const
+void WebRTCClient::queueFrame(const std::string &peer_id, std::string frame)
 {
-	std::vector<std::string> connected_peers;
-	for (const auto &[peer_id, peer] : peer_connections)
+	if (!coalescing_enabled)
 	{
-		if (peer.connected)
+		sendFrame(peer_id, frame);
+		return;
+	}
+
+	coalescing_stats.frames++;
+	auto [entry, created] = coalescers.try_emplace(peer_id);
+	MessageCoalescer &coalescer = entry->second;
+	auto latency = peer_latency.find(peer_id);
+	if (created && latency != peer_latency.end() && latency->second.estimator.hasEstimate())
+	{
+		coalescer.setRtt(std::chrono::microseconds(static_cast<int64_t>(latency->second.estimator.rttMs() * 1000.0)));
+	}
+	bool was_pending = coalescer.hasPending();
+	std::vector<std::string> out = coalescer.add(std::move(frame), MessageCoalescer::Clock::now());
+
+	// What add() released comes before anything it still holds, so this skips sendFrame's flush
+	auto channel = out.empty() ? nullptr : openChannel(peer_id);
+	for (const auto &message : out)
+	{
+		coalescing_stats.wire_messages++;
+		if (channel)
 		{
-			connected_peers.push_back(peer_id);
+			channel->send(message);
 		}
 	}
-	return connected_peers;
-}
 
-bool WebRTCClient::isConnectedToPeer(const std::string &peer_id) const
-{
-	auto it = peer_connections.find(peer_id);
-	return it != peer_connections.end() && it->second.connected;
+	// A new batch started: the timer thread has a new deadline to wait for
+	if (!was_pending && coalescer.hasPending())
+	{
+		coalesce_wake.notify_one();
+	}
 }
 
-void WebRTCClient::sendConnectionRequest(const std::string &targetClientId)
+void WebRTCClient::flushCoalescers(bool force)
 {
-	if (signaling_ws)
+	auto now = MessageCoalescer::Clock::now();
+	for (auto &[peer_id, coalescer] : coalescers)
 	{
-		json request_message = {
-			{"type", "connection-request"},
-			{"from", client_id},
-			{"to", targetClientId},
-			{"data", json::object()}};
-		signaling_ws->send(request_message.dump());
-		std::cout << "Sent connection request to " << targetClientId << std::endl;
+		if (auto batch = coalescer.flush(now, force))
+		{
+			coalescing_stats.wire_messages++;
+			sendFrame(peer_id, *batch);
+		}
 	}
 }
 
-void WebRTCClient::sendConnectionResponse(const std::string &targetClientId, bool accepted)
+void WebRTCClient::setCoalescingEnabled(bool enabled)
 {
-	if (signaling_ws)
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	if (!enabled)
 	{
-		json response_message = {
-			{"type", "connection-response"},
-			{"from", client_id},
-			{"to", targetClientId},
-			{"data", {{"accepted", accepted}}}};
-		signaling_ws->send(response_message.dump());
-		std::cout << "Sent connection " << (accepted ? "acceptance" : "rejection") << " to " << targetClientId << std::endl;
+		flushCoalescers(true);
 	}
+	else if (!coalesce_thread.joinable())
+	{
+		coalesce_thread = std::thread(&WebRTCClient::runCoalesceTimer, this);
+	}
+	coalescing_enabled = enabled;
 }
 
-void WebRTCClient::disconnectFromPeer(const std::string &peer_id)
+void WebRTCClient::runCoalesceTimer()
 {
-	auto it = peer_connections.find(peer_id);
-	if (it != peer_connections.end())
+	// Sends each batch when its window expires rather than on the next UI frame
+	std::unique_lock<std::mutex> lock(delivery_mutex);
+	while (!coalesce_stopping)
 	{
-		std::cout << "Disconnecting from " << peer_id << std::endl;
+		std::optional<MessageCoalescer::Clock::time_point> due;
+		for (const auto &[peer_id, coalescer] : coalescers)
+		{
+			auto deadline = coalescer.deadline();
+			if (deadline && (!due || *deadline < *due))
+			{
+				due = deadline;
+			}
+		}
+
+		if (due)
+		{
+			coalesce_wake.wait_until(lock, *due);
+		}
+		else
+		{
+			coalesce_wake.wait(lock);
+		}
+
+		if (!coalesce_stopping)
+		{
+			flushCoalescers(false);
+		}
+	}
+}
+
+bool WebRTCClient::isCoalescingEnabled() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return coalescing_enabled;
+}
+
+CoalescingStats WebRTCClient::getCoalescingStats() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return coalescing_stats;
+}
+
+static std::string makeDataFrame(uint64_t seq, uint64_t ack, int64_t sent_us, const std::string &body, uint64_t history_id,
+								 int64_t history_ts_us)
+{
+	json frame = {
+		{"type", "msg"},
+		{"seq", seq},
+		{"ack", ack},
+		{"ts", sent_us},
+		{"body", body}
+	};
+	if (history_id)
+	{
+		// "ts" is the sender's steady clock, for latency; the history entry has its own wall-clock time
+		frame["hid"] = history_id;
+		frame["hts"] = history_ts_us;
+	}
+	return frame.dump();
+}
+
+bool WebRTCClient::sendReliable(const std::string &peer_id, const std::string &payload, uint64_t history_id, int64_t history_ts_us, int64_t sent_us)
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	auto &session = delivery_sessions[peer_id];
+	int64_t now_us = sent_us ? sent_us : LatencyEstimator::nowMicros();
+	uint64_t seq = session.enqueue(payload, now_us, history_id, history_ts_us);
+	if (seq == 0)
+	{
+		return false; // Too much unacked already; nothing was taken
+	}
+	peer_activity[peer_id] = std::chrono::steady_clock::now();
+
+	// While the link is not ready the message just waits in the retransmit
+	// buffer and goes out when the peer resumes
+	if (session.isLinkReady())
+	{
+		queueFrame(peer_id, makeDataFrame(seq, session.takeAck(), now_us, payload, history_id, history_ts_us));
+	}
+	return true;
+}
+
+void WebRTCClient::retransmitUnacked(const std::string &peer_id, ReliableSession &session)
+{
+	const auto &pending = session.unacked();
+	if (pending.empty())
+	{
+		return;
+	}
+
+	std::cout << "Resuming " << peer_id << ": resending " << pending.size() << " unacked messages" << std::endl;
+	for (const auto &out : pending)
+	{
+		queueFrame(peer_id, makeDataFrame(out.seq, session.takeAck(), out.enqueued_us, out.payload, out.history_id, out.history_ts_us));
+	}
+	session.markRetransmitted(pending.size());
+}
+
+bool WebRTCClient::connectToSignalingServer(const std::string &url)
+{
+	try
+	{
+		signaling_ws = std::make_shared<rtc::WebSocket>();
+
+		signaling_ws->onOpen([this]()
+							 {
+                std::cout << "Connected to signaling server" << std::endl;
+                
+                // Join the server
+                json join_message = {
+                    {"type", "join"},
+                    {"from", client_id}
+                };
+                signaling_ws->send(join_message.dump()); });
+
+		signaling_ws->onMessage([this](rtc::message_variant message)
+								{
+                TRACE_SCOPE("ws.onMessage");
+                if (std::holds_alternative<std::string>(message)) {
+                    {
+                        std::lock_guard<std::mutex> lock(delivery_mutex);
+                        signaling_routes.received_websocket++;
+                    }
+                    // Signals relayed over data channels are captured as part of their channel message
+                    recorder.record(SessionEventKind::Signaling, {}, std::get<std::string>(message));
+                    handleSignalingMessage(std::move(std::get<std::string>(message)));
+                } });
+
+		signaling_ws->onClosed([this]()
+							   { std::cout << "Signaling server connection closed" << std::endl; });
+
+		signaling_ws->onError([this](std::string error)
+							  { std::cout << "Signaling error: " << error << std::endl; });
+
+		signaling_ws->open(url);
+
+		// Wait for connection
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		return true;
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "Failed to connect to signaling server: " << e.what() << std::endl;
+		return false;
+	}
+}
+
+bool WebRTCClient::startLanDiscovery()
+{
+	auto discovery = std::make_unique<LanDiscovery>(client_id);
+	discovery->onMessage = [this](std::string message)
+	{
+		TRACE_SCOPE("lan.onMessage");
+		{
+			std::lock_guard<std::mutex> lock(delivery_mutex);
+			signaling_routes.received_lan++;
+		}
+		recorder.record(SessionEventKind::Signaling, {}, message);
+		handleSignalingMessage(std::move(message));
+	};
+	if (!discovery->start())
+	{
+		return false;
+	}
+	lan = std::move(discovery);
+	return true;
+}
+
+LanDiscoveryStats WebRTCClient::getLanDiscoveryStats() const
+{
+	return lan ? lan->stats() : LanDiscoveryStats{};
+}
+
+void WebRTCClient::handleSignalingMessage(std::string message)
+{
+	TRACE_SCOPE("handleSignalingMessage");
+	std::cout << "Signaling message received: " << message << std::endl;
+
+	// Parsed in place: every field below is a view into 'message'
+	SignalingMessage msg;
+	if (!parseSignalingMessage(message, msg))
+	{
+		std::cout << "JSON parsing error: malformed signaling message" << std::endl;
+		return;
+	}
+
+	switch (msg.type)
+	{
+	case SignalingType::Offer:
+	{
+		// FLOW STEP 7: Receive WebRTC offer from the requester
+		std::string from_peer_id(msg.from);
+
+		std::cout << "Received offer from " << from_peer_id << ", creating answer..." << std::endl;
+
+		// A replayed session has no network behind it, so no peer connections are created
+		if (replayer)
+		{
+			break;
+		}
+
+		// Check if we already have a connection in progress
+		std::shared_ptr<rtc::PeerConnection> pc;
+		bool connected = false;
+		{
+			std::lock_guard<std::mutex> lock(peers_mutex);
+			auto it = peer_connections.find(from_peer_id);
+			if (it != peer_connections.end())
+			{
+				if (it->second.negotiation_in_progress)
+				{
+					std::cout << "Ignoring offer from " << from_peer_id << " - negotiation already in progress" << std::endl;
+					return;
+				}
+				pc = it->second.pc;
+				connected = it->second.connected;
+			}
+		}
+
+		std::string sdp(msg.data);
+		if (impairment)
+		{
+			sdp = impairment->rewriteSdp(sdp);
+		}
+
+		// An offer on an established connection renegotiates it (e.g. the peer added media tracks)
+		if (pc && connected)
+		{
+			// Both sides renegotiating at once (e.g. both started streaming): the lower
+			// client id's offer wins, as with simultaneous connection requests
+			bool reoffer = false;
+			if (pc->signalingState() == rtc::PeerConnection::SignalingState::HaveLocalOffer)
+			{
+				if (client_id < from_peer_id)
+				{
+					std::cout << "Ignoring renegotiation offer from " << from_peer_id << " - our offer wins" << std::endl;
+					break;
+				}
+				std::cout << "Renegotiation glare with " << from_peer_id << " - answering their offer, re-offering ours after" << std::endl;
+				reoffer = true;
+			}
+
+			try
+			{
+				if (reoffer)
+				{
+					pc->setLocalDescription(rtc::Description::Type::Rollback);
+				}
+				pc->setRemoteDescription(rtc::Description(sdp, "offer"));
+				pc->setLocalDescription();
+
+				// Our rolled-back tracks are still on the connection, just not negotiated yet
+				if (reoffer)
+				{
+					pc->setLocalDescription();
+				}
+			}
+			catch (const std::exception &e)
+			{
+				std::cout << "Renegotiation with " << from_peer_id << " failed: " << e.what() << std::endl;
+			}
+			break;
+		}
+
+		// Set up peer connection for this peer if not exists
+		if (!pc)
+		{
+			pc = setupPeerConnection(from_peer_id); // Sets up callbacks
+		}
+
+		// Closed or replaced by another thread in the meantime
+		if (!updateCurrentPeer(from_peer_id, pc.get(), [](PeerConnection &peer)
+							   { peer.negotiation_in_progress = true; }))
+		{
+			std::cout << "Connection to " << from_peer_id << " went away before the answer" << std::endl;
+			break;
+		}
+
+		try
+		{
+			// FLOW STEP 8: Set their offer as remote description, create our answer
+			pc->setRemoteDescription(rtc::Description(sdp, "offer"));
+			pc->setLocalDescription(); // Triggers onLocalDescription with "answer"
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Offer from " << from_peer_id << " rejected: " << e.what() << std::endl;
+			updateCurrentPeer(from_peer_id, pc.get(), [](PeerConnection &peer)
+							  { peer.negotiation_in_progress = false; });
+		}
+		break;
+	}
+	case SignalingType::Answer:
+	{
+		// FLOW STEP 9: Original requester receives the answer
+		std::string from_peer_id(msg.from);
+
+		std::cout << "Received answer from " << from_peer_id << std::endl;
+
+		if (auto pc = peerConnection(from_peer_id))
+		{
+			// Set their answer as remote description - now both sides have SDP
+			std::string sdp(msg.data);
+			if (impairment)
+			{
+				sdp = impairment->rewriteSdp(sdp);
+			}
+			try
+			{
+				pc->setRemoteDescription(rtc::Description(sdp, "answer"));
+				// WebRTC will now start ICE candidate exchange automatically
+			}
+			catch (const std::exception &e)
+			{
+				std::cout << "Answer from " << from_peer_id << " rejected: " << e.what() << std::endl;
+			}
+		}
+		break;
+	}
+	case SignalingType::IceCandidate:
+	{
+		// FLOW STEP 10: Exchange ICE candidates (happens multiple times)
+		std::string from_peer_id(msg.from);
+
+		std::cout << "Received ICE candidate from " << from_peer_id << std::endl;
+
+		if (auto pc = peerConnection(from_peer_id))
+		{
+			std::string candidate(msg.data);
+			if (impairment)
+			{
+				// Point the candidate at a relay port; candidates the relay cannot carry are dropped
+				auto relayed = impairment->rewriteCandidate(candidate);
+				if (!relayed)
+				{
+					break;
+				}
+				candidate = *relayed;
+			}
+
+			try
+			{
+				// Add their network path info so we can connect directly
+				pc->addRemoteCandidate(rtc::Candidate(candidate));
+			}
+			catch (const std::exception &e)
+			{
+				std::cout << "Failed to add ICE candidate from " << from_peer_id << ": " << e.what() << std::endl;
+			}
+		}
+		break;
+	}
+	case SignalingType::ClientList:
+	{
+		std::cout << "Updated client list received" << std::endl;
+
+		connected_clients.clear();
+
+		msg.forEachClient([this](std::string_view client)
+						  {
+				if (!client.empty() && client != client_id)
+				{ // Don't include self
+					connected_clients.emplace_back(client);
+				} });
+
+		std::cout << "Active clients: " << connected_clients.size() << std::endl;
+		break;
+	}
+	case SignalingType::ConnectionRequest:
+	{
+		// FLOW STEP 2 (Receiving): Someone wants to connect to us
+		std::cout << "Received connection request" << std::endl;
+
+		std::string from_client_id(msg.from);
+
+		// Queue it; the scheduler applies the auto-accept policy and the App
+		// shows the "Accept/Reject" popup for whatever is left to the user
+		bool known;
+		bool resume;
+		{
+			std::lock_guard<std::mutex> lock(delivery_mutex);
+			known = delivery_sessions.find(from_client_id) != delivery_sessions.end();
+			resume = hibernated_peers.count(from_client_id) > 0;
+		}
+		{
+			std::lock_guard<std::mutex> lock(handshake_mutex);
+			handshakes.onIncomingRequest(from_client_id, from_client_id, known, HandshakeScheduler::Clock::now(), resume);
+		}
+
+		if (onConnectionRequest)
+		{
+			onConnectionRequest(from_client_id, from_client_id);
+		}
+		break;
+	}
+	case SignalingType::ConnectionResponse:
+	{
+		// FLOW STEP 4: We get response to our connection request
+		std::string from_client_id(msg.from);
+		if (!msg.has_accepted)
+		{
+			std::cout << "Ignoring connection response without an answer from " << from_client_id << std::endl;
+			break;
+		}
+		bool accepted = msg.accepted;
+
+		if (accepted)
+		{
+			std::cout << "Connection accepted by " << from_client_id << std::endl;
+
+			// FLOW STEP 5: Since WE made the request, WE create the WebRTC offer
+			// This starts the actual peer-to-peer connection process
+			std::cout << "We initiated the request, so we create the offer to " << from_client_id << std::endl;
+			if (!replayer)
+			{
+				createOffer(from_client_id); // Creates data channel + WebRTC offer
+			}
+		}
+		else
+		{
+			std::cout << "Connection rejected by " << from_client_id << std::endl;
+			std::lock_guard<std::mutex> lock(handshake_mutex);
+			handshakes.onFailed(from_client_id, HandshakeScheduler::Clock::now());
+		}
+
+		if (onConnectionResponse)
+		{
+			onConnectionResponse(from_client_id, accepted);
+		}
+		break;
+	}
+	case SignalingType::Joined:
+	case SignalingType::Unknown:
+		break;
+	}
+}
+
+void WebRTCClient::createOffer(const std::string &peer_id)
+{
+	// FLOW STEP 5: Create WebRTC offer (called by the requester)
+	std::cout << "Creating offer for " << peer_id << "..." << std::endl;
+
+	// Set up peer connection if not exists
+	auto pc = peerConnection(peer_id);
+	if (!pc)
+	{
+		pc = setupPeerConnection(peer_id); // Sets up WebRTC peer connection + callbacks
+	}
+
+	// Closed or replaced by another thread in the meantime
+	if (!updateCurrentPeer(peer_id, pc.get(), [](PeerConnection &peer)
+						   {
+			peer.is_initiator = true;
+			peer.negotiation_in_progress = true; }))
+	{
+		std::cout << "Connection to " << peer_id << " went away before the offer" << std::endl;
+		return;
+	}
+
+	// Create data channel for chat messages (this will trigger offer creation)
+	setupDataChannel(peer_id, pc->createDataChannel("chat"));
+
+	// FLOW STEP 6: Generate SDP offer - this triggers onLocalDescription callback
+	pc->setLocalDescription(); // Async - callback sends offer to other peer
+}
+
+bool WebRTCClient::sendMessage(const std::string &msg, const std::string &peer_id)
+{
+	TRACE_SCOPE("sendMessage");
+	std::string full_message = client_id + ": " + msg;
+
+	if (peer_id.empty())
+	{
+		// Broadcasts are public: they carry an id into the shared history
+		int64_t sent_us = LatencyEstimator::nowMicros();
+		int64_t history_ts = HistorySync::wallMicros();
+		uint64_t history_id = HistorySync::makeId(client_id, history_ts, full_message);
+
+		// All connected peers, plus hibernated ones which get it queued and are woken up
+		std::vector<std::string> targets;
+		{
+			std::lock_guard<std::mutex> lock(peers_mutex);
+			for (auto &[id, peer] : peer_connections)
+			{
+				if (peer.connected && peer.data_channel)
+				{
+					targets.push_back(id);
+				}
+			}
+		}
+		size_t awake = targets.size();
+		{
+			std::lock_guard<std::mutex> lock(delivery_mutex);
+			targets.insert(targets.end(), hibernated_peers.begin(), hibernated_peers.end());
+
+			// All or nothing: a peer that is not keeping up holds the broadcast back for everyone
+			for (const auto &id : targets)
+			{
+				if (!delivery_sessions[id].canEnqueue(full_message.size()))
+				{
+					std::cout << "Broadcast not sent: " << id << " has too much unacknowledged, try again shortly" << std::endl;
+					return false;
+				}
+			}
+		}
+
+		// Only acks and session restarts touch the buffers meanwhile, and both free room
+		size_t sent = 0;
+		for (size_t i = 0; i < targets.size(); i++)
+		{
+			if (!sendReliable(targets[i], full_message, history_id, history_ts, sent_us))
+			{
+				continue;
+			}
+			sent++;
+			if (i >= awake)
+			{
+				connectToPeer(targets[i]);
+			}
+		}
+
+		if (sent > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(delivery_mutex);
+				history.add({history_id, history_ts, client_id, full_message});
+			}
+			addHistoryLine({"[You] " + msg, -1.0, history_id, history_ts});
+			std::cout << "Broadcast sent to " << sent << " peers: " << msg << std::endl;
+			return true;
+		}
+
+		std::cout << "No connected peers to send message to!" << std::endl;
+		return false;
+	}
+	else
+	{
+		// Send to specific peer
+		bool live;
+		{
+			std::lock_guard<std::mutex> lock(peers_mutex);
+			auto it = peer_connections.find(peer_id);
+			live = it != peer_connections.end() && it->second.connected && it->second.data_channel;
+		}
+		bool has_session;
+		{
+			std::lock_guard<std::mutex> lock(delivery_mutex);
+			has_session = delivery_sessions.find(peer_id) != delivery_sessions.end();
+		}
+
+		if (live || has_session)
+		{
+			if (!sendReliable(peer_id, full_message))
+			{
+				std::cout << "Not sent: " << peer_id << " has too much unacknowledged, try again shortly" << std::endl;
+				return false;
+			}
+		}
+
+		if (live)
+		{
+			addHistoryLine({"[You -> " + peer_id + "] " + msg, -1.0, 0, HistorySync::wallMicros()});
+			std::cout << "Sent to " << peer_id << ": " << msg << std::endl;
+		}
+		else if (has_session)
+		{
+			// We talked to this peer before - queued until it reconnects
+			addHistoryLine({"[You -> " + peer_id + "] " + msg + " (queued)", -1.0, 0, HistorySync::wallMicros()});
+			std::cout << "Queued for " << peer_id << " until it reconnects: " << msg << std::endl;
+
+			// A hibernated peer reconnects on demand
+			if (isHibernated(peer_id))
+			{
+				connectToPeer(peer_id);
+			}
+		}
+		else
+		{
+			std::cout << "Not connected to " << peer_id << "!" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void WebRTCClient::visitMessageHistory(const std::function<void(const std::vector<ChatMessage> &)> &visit) const
+{
+	std::lock_guard<std::mutex> lock(history_mutex);
+	visit(message_history);
+}
+
+void WebRTCClient::addHistoryLine(ChatMessage line)
+{
+	// Lines almost always arrive in order, so this is an append; a synced or late line slots in behind newer ones
+	std::lock_guard<std::mutex> lock(history_mutex);
+	auto position = std::upper_bound(message_history.begin(), message_history.end(), line.ts_us,
+									 [](int64_t ts, const ChatMessage &entry)
+									 { return ts < entry.ts_us; });
+	message_history.insert(position, std::move(line));
+}
+
+const std::vector<std::string> &WebRTCClient::getConnectedClients() const
+{
+	return connected_clients;
+}
+
+std::vector<std::string> WebRTCClient::getConnectedPeerIds() const
+{
+	std::vector<std::string> connected_peers;
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	for (const auto &[peer_id, peer] : peer_connections)
+	{
+		if (peer.connected)
+		{
+			connected_peers.push_back(peer_id);
+		}
+	}
+	return connected_peers;
+}
+
+bool WebRTCClient::isConnectedToPeer(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	auto it = peer_connections.find(peer_id);
+	return it != peer_connections.end() && it->second.connected;
+}
+
+double WebRTCClient::getGatheringTime(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	auto it = peer_connections.find(peer_id);
+	return it != peer_connections.end() ? it->second.gathering_ms : -1.0;
+}
+
+size_t WebRTCClient::getBufferedAmount(const std::string &peer_id) const
+{
+	std::shared_ptr<rtc::DataChannel> channel;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		auto it = peer_connections.find(peer_id);
+		if (it != peer_connections.end())
+		{
+			channel = it->second.data_channel;
+		}
+	}
+	return channel ? channel->bufferedAmount() : 0;
+}
+
+DeliveryStats WebRTCClient::getDeliveryStats(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	auto it = delivery_sessions.find(peer_id);
+	if (it == delivery_sessions.end())
+	{
+		return {};
+	}
+	return it->second.stats();
+}
+
+void WebRTCClient::update()
+{
+	TRACE_SCOPE("WebRTCClient::update");
+	replayEvents();
+
+	// In LAN mode the roster is whoever beaconed recently
+	if (lan)
+	{
+		std::vector<std::string> peers = lan->peers();
+		if (peers != connected_clients)
+		{
+			connected_clients = std::move(peers);
+		}
+	}
+
+	runHandshakes();
+	attachMediaStreams();
+	hibernateIdlePeers();
+	sampleResources();
+
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+
+	// Tell neighbors whenever the set of peers we can relay to changes
+	std::vector<std::string> neighbors = getConnectedPeerIds();
+	std::sort(neighbors.begin(), neighbors.end());
+	if (neighbors != advertised_neighbors)
+	{
+		advertised_neighbors = neighbors;
+		std::string frame = makeNeighborsFrame();
+		for (const auto &peer_id : neighbors)
+		{
+			sendFrame(peer_id, frame);
+		}
+	}
+
+	// Flush delayed acks for peers that went quiet after sending to us
+	auto now = ReliableSession::Clock::now();
+	for (auto &[peer_id, session] : delivery_sessions)
+	{
+		if (session.isLinkReady() && session.ackDue(now))
+		{
+			json ack = {
+				{"type", "ack"},
+				{"ack", session.takeAck()}
+			};
+			sendFrame(peer_id, ack.dump());
+		}
+	}
+
+	// Re-run reconciliations that went quiet without settling: a frame was lost, or items moved and need checking
+	auto steady_now = std::chrono::steady_clock::now();
+	for (auto &[peer_id, round] : history_rounds)
+	{
+		auto session = delivery_sessions.find(peer_id);
+		if (session != delivery_sessions.end() && session->second.isLinkReady() &&
+			steady_now - round.last_frame >= HISTORY_RESYNC_AFTER)
+		{
+			round = {steady_now, false};
+			sendFrame(peer_id, history.begin());
+		}
+	}
+
+	// Latency probes on every open link
+	int64_t now_us = LatencyEstimator::nowMicros();
+	for (const auto &[peer_id, session] : delivery_sessions)
+	{
+		auto &latency = peer_latency[peer_id];
+		if (session.isLinkReady() && now_us - latency.last_ping_us >= PING_INTERVAL_US)
+		{
+			latency.last_ping_us = now_us;
+			json ping = {
+				{"type", "ping"},
+				{"t0", now_us}
+			};
+			sendFrame(peer_id, ping.dump());
+		}
+	}
+}
+
+void WebRTCClient::replayEvents()
+{
+	if (!replayer || replayer->finished())
+	{
+		return;
+	}
+
+	TRACE_SCOPE("replayEvents");
+	auto started = std::chrono::steady_clock::now();
+	for (auto &event : replayer->poll(started))
+	{
+		switch (event.kind)
+		{
+		case SessionEventKind::Signaling:
+			handleSignalingMessage(std::move(event.payload));
+			break;
+		case SessionEventKind::ChannelOpen:
+			// Stands in for the peer connection state change; frames sent to it go nowhere.
+			// The entry has no pc: offers and createOffer are skipped while replaying, and
+			// every other path checks for one.
+			{
+				std::lock_guard<std::mutex> lock(peers_mutex);
+				peer_connections[event.peer].connected = true;
+			}
+			handleChannelOpen(event.peer);
+			break;
+		case SessionEventKind::ChannelMessage:
+			handleChannelMessage(event.peer, event.payload);
+			break;
+		case SessionEventKind::ChannelClosed:
+			handleChannelClosed(event.peer);
+			break;
+		}
+	}
+	replay_handling_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+	if (replayer->finished())
+	{
+		std::cout << "Replay finished: " << replayer->size() << " events handled in " << replay_handling_ms << " ms" << std::endl;
+	}
+}
+
+bool WebRTCClient::startRecording(const std::string &path)
+{
+	return recorder.open(path, client_id);
+}
+
+void WebRTCClient::stopRecording()
+{
+	recorder.close();
+}
+
+bool WebRTCClient::startReplay(const std::string &path, double speed)
+{
+	auto trace = std::make_unique<SessionReplayer>();
+	if (!trace->load(path))
+	{
+		return false;
+	}
+
+	// Take the recorded identity so the roster and message routing match the original session
+	if (!trace->clientId().empty())
+	{
+		client_id = trace->clientId();
+	}
+	trace->start(speed, SessionReplayer::Clock::now());
+	replayer = std::move(trace);
+	replay_handling_ms = 0.0;
+	std::cout << "Replaying as " << client_id << " at " << (speed > 0.0 ? std::to_string(speed) + "x" : std::string("full speed")) << std::endl;
+	return true;
+}
+
+ReplayProgress WebRTCClient::getReplayProgress() const
+{
+	ReplayProgress progress;
+	if (replayer)
+	{
+		progress.position = replayer->position();
+		progress.total = replayer->size();
+		progress.speed = replayer->speed();
+		progress.handling_ms = replay_handling_ms;
+		progress.finished = replayer->finished();
+	}
+	return progress;
+}
+
+#ifdef CLIENT_BENCHMARK_HOOKS
+void WebRTCClient::loadSyntheticState(size_t roster, size_t history_lines, size_t connected_peers)
+{
+	connected_clients.clear();
+	for (size_t i = 0; i < roster; i++)
+	{
+		connected_clients.push_back("user_" + std::to_string(100000 + i));
+	}
+
+	// The first peers of the roster count as connected; their entries have no pc or channel behind them
+	connected_peers = std::min(connected_peers, roster);
+	int64_t now_us = LatencyEstimator::nowMicros();
+	{
+		std::lock_guard<std::mutex> lock(delivery_mutex);
+		for (size_t i = 0; i < connected_peers; i++)
+		{
+			const std::string &peer_id = connected_clients[i];
+			{
+				std::lock_guard<std::mutex> peers_lock(peers_mutex);
+				PeerConnection &peer = peer_connections[peer_id];
+				peer.connected = true;
+				peer.gathering_ms = 20.0 + static_cast<double>(i % 50);
+			}
+
+			// A few peers with unacked messages
+			ReliableSession &session = delivery_sessions[peer_id];
+			for (size_t m = 0; m < i % 4; m++)
+			{
+				session.enqueue("synthetic", now_us);
+			}
+
+			LatencyReport &report = peer_latency[peer_id].report;
+			report.rtt_ms = 10.0 + static_cast<double>(i % 90);
+			for (int sample = 0; sample < 64; sample++)
+			{
+				report.rtt.add(report.rtt_ms * (1.0 + sample / 64.0));
+				report.one_way.add(report.rtt_ms * 0.5 * (1.0 + sample / 32.0));
+			}
+		}
+	}
+
+	// Mix of the line kinds the history panel draws differently, with bodies long enough to scroll sideways now and then
+	std::lock_guard<std::mutex> history_lock(history_mutex);
+	message_history.clear();
+	message_history.reserve(history_lines);
+	int64_t wall_us = HistorySync::wallMicros();
+	for (size_t i = 0; i < history_lines; i++)
+	{
+		const std::string &from = roster ? connected_clients[i % roster] : client_id;
+		std::string body = "message " + std::to_string(i) + std::string(i % 7 == 0 ? 160 : 24, 'x');
+		ChatMessage line{"[" + from + "] " + body, -1.0, 0, wall_us - static_cast<int64_t>(history_lines - i) * 1000};
+		if (i % 3 == 1)
+		{
+			line.latency_ms = 5.0 + static_cast<double>(i % 40);
+		}
+		line.synced = i % 10 == 9;
+		message_history.push_back(std::move(line));
+	}
+}
+#endif
+
+HistorySyncStats WebRTCClient::getHistorySyncStats() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return history.stats();
+}
+
+LatencyReport WebRTCClient::getLatencyReport(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	auto it = peer_latency.find(peer_id);
+	return it != peer_latency.end() ? it->second.report : LatencyReport{};
+}
+
+void WebRTCClient::sendConnectionRequest(const std::string &targetClientId)
+{
+	json request_message = {
+		{"type", "connection-request"},
+		{"from", client_id},
+		{"to", targetClientId},
+		{"data", json::object()}};
+	sendSignal(request_message);
+	std::cout << "Sent connection request to " << targetClientId << std::endl;
+}
+
+void WebRTCClient::sendConnectionResponse(const std::string &targetClientId, bool accepted)
+{
+	json response_message = {
+		{"type", "connection-response"},
+		{"from", client_id},
+		{"to", targetClientId},
+		{"data", {{"accepted", accepted}}}};
+	sendSignal(response_message);
+	std::cout << "Sent connection " << (accepted ? "acceptance" : "rejection") << " to " << targetClientId << std::endl;
+}
+
+void WebRTCClient::disconnectFromPeer(const std::string &peer_id)
+{
+	bool known;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		known = peer_connections.find(peer_id) != peer_connections.end();
+	}
+	if (!known && !isHibernated(peer_id))
+	{
+		return;
+	}
 
-		// Close data channel first
-		if (it->second.data_channel)
+	std::cout << "Disconnecting from " << peer_id << std::endl;
+	closePeer(peer_id);
+
+	// An explicit disconnect also forgets the delivery session - nothing to resume
+	size_t unsent = 0;
+	{
+		std::lock_guard<std::mutex> lock(delivery_mutex);
+		auto session = delivery_sessions.find(peer_id);
+		if (session != delivery_sessions.end())
 		{
-			it->second.data_channel->close();
+			unsent = session->second.unacked().size();
+			delivery_sessions.erase(session);
 		}
+		coalescers.erase(peer_id);
+		peer_latency.erase(peer_id);
+		history_rounds.erase(peer_id);
+		neighbor_peers.erase(peer_id);
+		peer_activity.erase(peer_id);
+		hibernated_peers.erase(peer_id);
+	}
+	{
+		std::lock_guard<std::mutex> lock(handshake_mutex);
+		handshakes.forget(peer_id);
+	}
+
+	// The only way messages are given up on: say so where they were shown as sent
+	if (unsent > 0)
+	{
+		addHistoryLine({"[You -> " + peer_id + "] " + std::to_string(unsent) + " messages not confirmed before the disconnect, may not have arrived",
+						-1.0, 0, HistorySync::wallMicros()});
+	}
+	std::cout << "Disconnected from " << peer_id << (unsent ? " (" + std::to_string(unsent) + " unconfirmed messages dropped)" : "") << std::endl;
+}
 
-		// Close peer connection
-		if (it->second.pc)
+void WebRTCClient::closePeer(const std::string &peer_id)
+{
+	// Out of the map first: the close callbacks must not find it
+	PeerConnection removed;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		auto it = peer_connections.find(peer_id);
+		if (it == peer_connections.end())
 		{
-			it->second.pc->close();
+			return;
 		}
-
-		// Remove from our connections map
+		removed = std::move(it->second);
 		peer_connections.erase(it);
+	}
+	auto channel = removed.data_channel;
+	auto pc = removed.pc;
+
+	for (auto &stream : media_streams)
+	{
+		stream->detach(peer_id);
+	}
+
+	// Close data channel first
+	if (channel)
+	{
+		channel->close();
+	}
+	if (pc)
+	{
+		pc->close();
+	}
+}
+
+void WebRTCClient::hibernateIdlePeers()
+{
+	// Peers told to hibernate last frame: the notice has gone out, close the connection
+	std::vector<std::string> closing;
+	{
+		std::lock_guard<std::mutex> lock(delivery_mutex);
+		closing.swap(hibernating);
+	}
+	for (const auto &peer_id : closing)
+	{
+		std::cout << "Hibernating idle peer " << peer_id << std::endl;
+		closePeer(peer_id);
+	}
+
+	// Streaming peers are never idle
+	if (replayer || !media_streams.empty())
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	if (hibernate_after == std::chrono::steady_clock::duration::zero())
+	{
+		return;
+	}
+
+	// Connected peers that do not stream to us
+	std::vector<std::string> candidates;
+	{
+		std::lock_guard<std::mutex> peers_lock(peers_mutex);
+		for (const auto &[peer_id, peer] : peer_connections)
+		{
+			if (peer.connected && peer.remote_tracks.empty())
+			{
+				candidates.push_back(peer_id);
+			}
+		}
+	}
+
+	for (const auto &peer_id : candidates)
+	{
+		if (hibernated_peers.count(peer_id))
+		{
+			continue;
+		}
+
+		// Only settled links: resumed, nothing waiting for an ack
+		auto session = delivery_sessions.find(peer_id);
+		auto active = peer_activity.find(peer_id);
+		if (session == delivery_sessions.end() || !session->second.isLinkReady() || !session->second.unacked().empty() ||
+			active == peer_activity.end() || now - active->second < hibernate_after)
+		{
+			continue;
+		}
+
+		json notice = {{"type", "hibernate"}};
+		sendFrame(peer_id, notice.dump());
+		hibernated_peers.insert(peer_id);
+		hibernating.push_back(peer_id);
+		hibernation_stats.hibernations++;
+	}
+}
+
+void WebRTCClient::setHibernateAfter(std::chrono::seconds idle)
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	hibernate_after = idle;
+	std::cout << "Idle peers hibernate after " << idle.count() << " s" << (idle.count() ? "" : " (disabled)") << std::endl;
+}
+
+std::chrono::seconds WebRTCClient::getHibernateAfter() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return std::chrono::duration_cast<std::chrono::seconds>(hibernate_after);
+}
+
+bool WebRTCClient::isHibernated(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return hibernated_peers.count(peer_id) > 0;
+}
+
+HibernationStats WebRTCClient::getHibernationStats() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	HibernationStats stats = hibernation_stats;
+	stats.hibernated = hibernated_peers.size();
+	return stats;
+}
+
+void WebRTCClient::sampleResources()
+{
+	auto now = std::chrono::steady_clock::now();
+	if (now - last_resource_sample < std::chrono::seconds(1))
+	{
+		return;
+	}
+
+	ProcessStats process = ProcessStats::sample();
+	size_t live = 0;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		for (const auto &[peer_id, peer] : peer_connections)
+		{
+			if (peer.pc)
+			{
+				live++;
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	if (last_resource_sample != std::chrono::steady_clock::time_point{})
+	{
+		double elapsed = std::chrono::duration<double>(now - last_resource_sample).count();
+		resources.wakeups_per_sec = static_cast<double>(process.context_switches - resources.process.context_switches) / elapsed;
+	}
+	resources.process = process;
+	resources.live_peers = live;
+	resources.hibernated_peers = hibernated_peers.size();
+	last_resource_sample = now;
+}
+
+ResourceReport WebRTCClient::getResourceReport() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return resources;
+}
+
+void WebRTCClient::runHandshakes()
+{
+	std::vector<HandshakeScheduler::Action> actions;
+	{
+		std::lock_guard<std::mutex> lock(handshake_mutex);
+		actions = handshakes.poll(HandshakeScheduler::Clock::now());
+	}
+
+	// Signaling happens outside the lock; responses can arrive on the WebSocket thread meanwhile
+	for (const auto &action : actions)
+	{
+		switch (action.kind)
+		{
+		case HandshakeScheduler::Action::Kind::SendRequest:
+			sendConnectionRequest(action.peer_id);
+			break;
+		case HandshakeScheduler::Action::Kind::Accept:
+			sendConnectionResponse(action.peer_id, true);
+			break;
+		case HandshakeScheduler::Action::Kind::Reject:
+			sendConnectionResponse(action.peer_id, false);
+			break;
+		case HandshakeScheduler::Action::Kind::Abort:
+		{
+			// Give up on the half-open connection but keep the delivery session
+			std::cout << "Handshake with " << action.peer_id << " timed out" << std::endl;
+			PeerConnection removed;
+			{
+				std::lock_guard<std::mutex> lock(peers_mutex);
+				auto it = peer_connections.find(action.peer_id);
+				if (it != peer_connections.end() && !it->second.connected)
+				{
+					removed = std::move(it->second);
+					peer_connections.erase(it);
+				}
+			}
+			if (removed.pc)
+			{
+				removed.pc->close();
+			}
+			break;
+		}
+		}
+	}
+}
+
+void WebRTCClient::connectToPeer(const std::string &peer_id)
+{
+	if (isConnectedToPeer(peer_id))
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	handshakes.connectTo(peer_id, HandshakeScheduler::Clock::now());
+}
+
+void WebRTCClient::connectToAll()
+{
+	auto now = HandshakeScheduler::Clock::now();
+	size_t queued = 0;
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	for (const auto &peer_id : connected_clients)
+	{
+		if (!isConnectedToPeer(peer_id) && !handshakes.isBusy(peer_id))
+		{
+			handshakes.connectTo(peer_id, now);
+			queued++;
+		}
+	}
+	std::cout << "Queued " << queued << " connection requests (" << handshakes.maxInFlight() << " at a time)" << std::endl;
+}
+
+bool WebRTCClient::isHandshakePending(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	return handshakes.isBusy(peer_id);
+}
+
+void WebRTCClient::acceptConnectionRequest(const std::string &peer_id)
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	handshakes.resolve(peer_id, true, HandshakeScheduler::Clock::now());
+}
+
+void WebRTCClient::rejectConnectionRequest(const std::string &peer_id)
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	handshakes.resolve(peer_id, false, HandshakeScheduler::Clock::now());
+}
+
+std::vector<IncomingRequest> WebRTCClient::getPendingRequests() const
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	const auto &pending = handshakes.pendingRequests();
+	return std::vector<IncomingRequest>(pending.begin(), pending.end());
+}
+
+void WebRTCClient::setAutoAcceptPolicy(AutoAcceptPolicy policy)
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	handshakes.setPolicy(policy);
+}
+
+AutoAcceptPolicy WebRTCClient::getAutoAcceptPolicy() const
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	return handshakes.getPolicy();
+}
+
+void WebRTCClient::setMaxConcurrentHandshakes(size_t limit)
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	handshakes.setMaxInFlight(limit);
+}
+
+size_t WebRTCClient::getMaxConcurrentHandshakes() const
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	return handshakes.maxInFlight();
+}
+
+HandshakeStats WebRTCClient::getHandshakeStats() const
+{
+	std::lock_guard<std::mutex> lock(handshake_mutex);
+	return handshakes.stats();
+}
+
+bool WebRTCClient::startMediaStream(const std::string &path, double video_fps)
+{
+	auto source = MediaSource::load(path, video_fps);
+	if (!source)
+	{
+		return false;
+	}
+
+	std::string mid = (source->kind() == MediaSource::Kind::H264 ? "video" : "audio") + std::to_string(media_streams_started++);
+	media_streams.push_back(std::make_unique<MediaStreamer>(source, mid));
+	media_streams.back()->start();
+	return true; // Tracks are added to peers on the next update()
+}
+
+void WebRTCClient::stopMediaStreams()
+{
+	// Stop the pacing threads and close the tracks; peers drop them on the next offer/answer round
+	std::vector<std::pair<std::string, std::shared_ptr<rtc::PeerConnection>>> renegotiate;
+	for (auto &stream : media_streams)
+	{
+		stream->stop();
+		for (auto &connection : stream->closeTracks())
+		{
+			if (std::find(renegotiate.begin(), renegotiate.end(), connection) == renegotiate.end())
+			{
+				renegotiate.push_back(std::move(connection));
+			}
+		}
+	}
+	media_streams.clear();
+
+	for (const auto &[peer_id, pc] : renegotiate)
+	{
+		if (isCurrentConnection(peer_id, pc.get()))
+		{
+			std::cout << "Renegotiating with " << peer_id << " to remove media tracks" << std::endl;
+			pc->setLocalDescription();
+		}
+	}
+}
+
+std::vector<MediaStreamStats> WebRTCClient::getMediaStats() const
+{
+	std::vector<MediaStreamStats> result;
+	for (const auto &stream : media_streams)
+	{
+		result.push_back(stream->stats());
+	}
+	return result;
+}
+
+void WebRTCClient::attachMediaStreams()
+{
+	if (media_streams.empty())
+	{
+		return;
+	}
+
+	std::vector<std::pair<std::string, std::shared_ptr<rtc::PeerConnection>>> ready;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		for (const auto &[peer_id, peer] : peer_connections)
+		{
+			if (peer.connected && !peer.negotiation_in_progress && peer.pc)
+			{
+				ready.emplace_back(peer_id, peer.pc);
+			}
+		}
+	}
+
+	for (const auto &[peer_id, pc] : ready)
+	{
+		bool added = false;
+		for (auto &stream : media_streams)
+		{
+			if (!stream->isAttached(peer_id, pc) && stream->attach(peer_id, pc))
+			{
+				added = true;
+			}
+		}
+
+		// New tracks need a fresh offer/answer round on the existing connection
+		if (added)
+		{
+			std::cout << "Renegotiating with " << peer_id << " to add media tracks" << std::endl;
+			pc->setLocalDescription();
+		}
+	}
+}
+
+bool WebRTCClient::isCurrentConnection(const std::string &peer_id, const rtc::PeerConnection *pc) const
+{
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	auto it = peer_connections.find(peer_id);
+	return it != peer_connections.end() && it->second.pc.get() == pc;
+}
+
+bool WebRTCClient::updateCurrentPeer(const std::string &peer_id, const rtc::PeerConnection *pc,
+									 const std::function<void(PeerConnection &)> &update)
+{
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	auto it = peer_connections.find(peer_id);
+	if (it == peer_connections.end() || it->second.pc.get() != pc)
+	{
+		return false;
+	}
+	update(it->second);
+	return true;
+}
+
+std::shared_ptr<rtc::PeerConnection> WebRTCClient::peerConnection(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	auto it = peer_connections.find(peer_id);
+	return it != peer_connections.end() ? it->second.pc : nullptr;
+}
+
+std::shared_ptr<rtc::DataChannel> WebRTCClient::openChannel(const std::string &peer_id) const
+{
+	std::shared_ptr<rtc::DataChannel> channel;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		auto it = peer_connections.find(peer_id);
+		if (it != peer_connections.end())
+		{
+			channel = it->second.data_channel;
+		}
+	}
+	return channel && channel->isOpen() ? channel : nullptr;
+}
+
+bool WebRTCClient::canSignalDirectly(const std::string &peer_id) const
+{
+	std::shared_ptr<rtc::DataChannel> channel;
+	{
+		std::lock_guard<std::mutex> lock(peers_mutex);
+		auto it = peer_connections.find(peer_id);
+		if (it == peer_connections.end() || !it->second.connected)
+		{
+			return false;
+		}
+		channel = it->second.data_channel;
+	}
+	return channel && channel->isOpen();
+}
 
-		std::cout << "Disconnected from " << peer_id << std::endl;
+std::string WebRTCClient::makeNeighborsFrame() const
+{
+	json frame = {
+		{"type", "neighbors"},
+		{"peers", getConnectedPeerIds()}
+	};
+	return frame.dump();
+}
+
+void WebRTCClient::sendSignal(const json &message)
+{
+	std::string to = message.value("to", "");
+	std::string payload = message.dump();
+	{
+		std::lock_guard<std::mutex> lock(delivery_mutex);
+		if (mesh_signaling && !to.empty())
+		{
+			// Renegotiation: straight over the connection being renegotiated
+			if (canSignalDirectly(to))
+			{
+				json frame = {
+					{"type", "signal"},
+					{"signal", message}
+				};
+				std::string wire = frame.dump();
+				signaling_routes.direct++;
+				signaling_routes.mesh_bytes += wire.size();
+				sendFrame(to, wire);
+				return;
+			}
+
+			// Introduction: through a neighbor that is connected to the target
+			for (const auto &[neighbor, peers] : neighbor_peers)
+			{
+				if (std::find(peers.begin(), peers.end(), to) != peers.end() && canSignalDirectly(neighbor))
+				{
+					json frame = {
+						{"type", "relay"},
+						{"to", to},
+						{"signal", message}
+					};
+					std::string wire = frame.dump();
+					signaling_routes.relayed++;
+					signaling_routes.mesh_bytes += wire.size();
+					sendFrame(neighbor, wire);
+					return;
+				}
+			}
+		}
+
+		// LAN mode: straight to the target's discovery socket
+		if (lan && !to.empty() && lan->send(to, payload))
+		{
+			signaling_routes.lan++;
+			return;
+		}
+
+		// First contact: only the server knows how to reach them
+		signaling_routes.websocket++;
+		signaling_routes.websocket_bytes += payload.size();
+	}
+
+	if (signaling_ws)
+	{
+		signaling_ws->send(payload);
 	}
 }
+
+void WebRTCClient::setMeshSignaling(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	mesh_signaling = enabled;
+}
+
+bool WebRTCClient::isMeshSignaling() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return mesh_signaling;
+}
+
+SignalingRouteStats WebRTCClient::getSignalingRouteStats() const
+{
+	std::lock_guard<std::mutex> lock(delivery_mutex);
+	return signaling_routes;
+}
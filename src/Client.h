@@ -1,3 +1,5 @@
+#pragma once
+
 #include "rtc/rtc.hpp"
 #include <iostream>
 #include <thread>
@@ -6,15 +8,93 @@
 #include <vector>
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <nlohmann/json_fwd.hpp>
+
+#include "HandshakeScheduler.h"
+#include "HistorySync.h"
+#include "ImpairmentRelay.h"
+#include "LanDiscovery.h"
+#include "LatencyProbe.h"
+#include "MediaStreamer.h"
+#include "MessageCoalescer.h"
+#include "ProcessStats.h"
+#include "ReliableDelivery.h"
+#include "SessionRecorder.h"
+#include "TransportProfile.h"
 
 // Structure to hold each peer's connection data
 struct PeerConnection
 {
-	std::shared_ptr<rtc::PeerConnection> pc;
+	std::shared_ptr<rtc::PeerConnection> pc; // Null for replayed and synthetic peers: check before every use
 	std::shared_ptr<rtc::DataChannel> data_channel;
 	bool connected = false;
 	bool is_initiator = false; // true if we initiated the connection
 	bool negotiation_in_progress = false; // prevent simultaneous negotiations
+	std::chrono::steady_clock::time_point gathering_started;
+	double gathering_ms = -1.0; // ICE gathering duration, -1 until complete
+	std::vector<std::shared_ptr<rtc::Track>> remote_tracks; // Media the peer streams to us
+};
+
+// One line of the chat history
+struct ChatMessage
+{
+	std::string text;		  // Formatted line as shown in the UI
+	double latency_ms = -1.0; // Clock-corrected one-way latency for received messages, -1 if unknown
+	uint64_t history_id = 0;  // Entry in the shared (public) history, 0 for private lines
+	int64_t ts_us = 0;		  // Wall clock the line sorts by: when it was shown, or the sender's for synced lines
+	bool synced = false;	  // Missed while offline, fetched by history sync
+};
+
+// Per-peer latency figures from the ping/pong probes
+struct LatencyReport
+{
+	double rtt_ms = -1.0;	 // Filtered round-trip time, -1 before the first pong
+	double offset_ms = 0.0;	 // Peer clock minus our clock
+	LatencyHistogram rtt;	 // Every probe's round-trip time
+	LatencyHistogram one_way; // Send-to-receive time of chat messages (includes sender-side queueing)
+};
+
+// Where signaling messages went (see WebRTCClient::sendSignal)
+struct SignalingRouteStats
+{
+	uint64_t websocket = 0; // Sent to the signaling server
+	uint64_t lan = 0;		// Straight to the peer's LAN discovery socket
+	uint64_t direct = 0;	// Over our data channel to the target itself
+	uint64_t relayed = 0;	// Via a neighbor that is connected to the target
+	uint64_t forwarded = 0; // Relayed by us on behalf of other peers
+	uint64_t websocket_bytes = 0;
+	uint64_t mesh_bytes = 0;
+	uint64_t received_websocket = 0;
+	uint64_t received_mesh = 0;
+	uint64_t received_lan = 0;
+
+	double websocketShare() const
+	{
+		uint64_t total = websocket + lan + direct + relayed;
+		return total ? static_cast<double>(websocket) / static_cast<double>(total) : 0.0;
+	}
+};
+
+// Idle-peer hibernation counters
+struct HibernationStats
+{
+	size_t hibernated = 0;	   // Peers currently closed but remembered
+	uint64_t hibernations = 0; // Idle peers we (or the peer) closed
+	uint64_t resumes = 0;	   // Hibernated peers that reconnected
+};
+
+// How far a session replay has got
+struct ReplayProgress
+{
+	size_t position = 0; // Events dispatched so far
+	size_t total = 0;
+	double speed = 1.0;	 // 0 = as fast as possible
+	double handling_ms = 0.0; // Time spent inside the client handling replayed events
+	bool finished = false;
 };
 
 // Simple WebSocket client using libdatachannel's built-in WebSocket
@@ -22,37 +102,222 @@ class WebRTCClient
 {
 private:
 	std::shared_ptr<rtc::WebSocket> signaling_ws;
+	std::unique_ptr<LanDiscovery> lan; // Serverless alternative to signaling_ws
 	std::string client_id;
-	std::vector<std::string> message_history;
+	TransportProfile transport;
+	std::shared_ptr<ImpairmentRelay> impairment; // Optional: routes peer traffic through a lossy local relay
+	// Appended from the channel threads while the UI draws it, so always under history_mutex.
+	// Innermost like peers_mutex: taken under delivery_mutex, nothing is locked inside it.
+	std::vector<ChatMessage> message_history;
+	mutable std::mutex history_mutex;
 	std::vector<std::string> connected_clients;
 	
-	// Map of peer_id -> PeerConnection
+	// Map of peer_id -> PeerConnection. Touched from the UI, WebSocket, LAN, coalescing and
+	// libdatachannel threads, so always under peers_mutex. That lock is innermost: nothing
+	// else is locked and no pc or channel method is called while it is held.
 	std::unordered_map<std::string, PeerConnection> peer_connections;
-	
+	mutable std::mutex peers_mutex;
+
+	// Map of peer_id -> delivery session. Kept across reconnects so unacked
+	// messages can be resumed; only dropped on an explicit disconnect.
+	std::unordered_map<std::string, ReliableSession> delivery_sessions;
+	mutable std::mutex delivery_mutex; // Also guards the coalescing state below
+
+	// Optional small-message batching per peer (opt-in)
+	bool coalescing_enabled = false;
+	std::unordered_map<std::string, MessageCoalescer> coalescers;
+	CoalescingStats coalescing_stats;
+	std::thread coalesce_thread; // Flushes batches at their deadline, started on first enable
+	std::condition_variable coalesce_wake; // Used with delivery_mutex
+	bool coalesce_stopping = false;
+
+	// Mesh signaling: peers we can reach through each neighbor, learned from "neighbors" frames
+	bool mesh_signaling = true;
+	std::unordered_map<std::string, std::vector<std::string>> neighbor_peers;
+	std::vector<std::string> advertised_neighbors; // Last list we sent out
+	std::vector<std::string> inbound_signals;	   // Received over data channels, handled once the lock is released
+	SignalingRouteStats signaling_routes;
+
+	// Idle peers are closed but keep their delivery session, and reconnect on the next send or request
+	std::chrono::steady_clock::duration hibernate_after{0}; // 0 = never
+	std::unordered_map<std::string, std::chrono::steady_clock::time_point> peer_activity; // Last chat message either way
+	std::unordered_set<std::string> hibernated_peers;
+	std::vector<std::string> hibernating; // Told to hibernate last frame, closed this frame
+	HibernationStats hibernation_stats;
+
+	// Process cost of the mesh, sampled about once a second from update()
+	ResourceReport resources;
+	std::chrono::steady_clock::time_point last_resource_sample;
+
+	// Public messages, reconciled with each peer when its link comes up
+	HistorySync history;
+	// Reconciliations we opened (the lower id opens), re-run while a round exchanged items or went quiet unsettled
+	struct HistoryRound
+	{
+		std::chrono::steady_clock::time_point last_frame;
+		bool exchanged = false;
+	};
+	std::unordered_map<std::string, HistoryRound> history_rounds;
+	static constexpr std::chrono::seconds HISTORY_RESYNC_AFTER{3};
+
+	// Ping/pong latency probes per peer
+	struct PeerLatency
+	{
+		LatencyEstimator estimator;
+		LatencyReport report;
+		int64_t last_ping_us = 0;
+	};
+	std::unordered_map<std::string, PeerLatency> peer_latency;
+	static constexpr int64_t PING_INTERVAL_US = 1000000;
+
+	// Incoming request queue and the limit on concurrent negotiations
+	HandshakeScheduler handshakes;
+	mutable std::mutex handshake_mutex;
+
+	// Pre-encoded clips streamed to every connected peer
+	std::vector<std::unique_ptr<MediaStreamer>> media_streams;
+	size_t media_streams_started = 0; // Numbers the mids: a stopped stream's mid stays in the session as a removed m-line
+	std::atomic<uint64_t> media_packets_received{0};
+
+	// Session capture and offline replay (see SessionRecorder)
+	SessionRecorder recorder;
+	std::unique_ptr<SessionReplayer> replayer;
+	double replay_handling_ms = 0.0;
+
+	void handleChannelOpen(const std::string& peer_id);
+	void handleChannelMessage(const std::string& peer_id, const std::string& message);
+	void handleChannelClosed(const std::string& peer_id);
+	void handleChannelFrame(const std::string& peer_id, ReliableSession& session, const nlohmann::json& frame, size_t wire_bytes);
+	bool sendReliable(const std::string& peer_id, const std::string& payload, uint64_t history_id = 0, int64_t history_ts_us = 0, int64_t sent_us = 0); // sent_us 0 = now; false if the session buffer is full
+	void addHistoryLine(ChatMessage line); // Keeps message_history ordered by ts_us
+	void sendFrame(const std::string& peer_id, const std::string& frame); // Bypasses coalescing
+	void queueFrame(const std::string& peer_id, std::string frame);		 // Coalesced when enabled
+	void flushCoalescers(bool force);
+	void runCoalesceTimer();
+	void retransmitUnacked(const std::string& peer_id, ReliableSession& session);
+	void runHandshakes();
+	void sendSignal(const nlohmann::json& message); // Offers, answers, candidates, requests: mesh first, WebSocket as fallback
+	bool canSignalDirectly(const std::string& peer_id) const;
+	bool isCurrentConnection(const std::string& peer_id, const rtc::PeerConnection* pc) const; // pc is still the one in peer_connections
+	bool updateCurrentPeer(const std::string& peer_id, const rtc::PeerConnection* pc, const std::function<void(PeerConnection&)>& update); // Under peers_mutex; false once pc was replaced
+	std::shared_ptr<rtc::PeerConnection> peerConnection(const std::string& peer_id) const;
+	std::shared_ptr<rtc::DataChannel> openChannel(const std::string& peer_id) const; // nullptr unless open
+	std::string makeNeighborsFrame() const;
+	void attachMediaStreams();
+	void hibernateIdlePeers();
+	void closePeer(const std::string& peer_id); // Tears the connection down, keeps the delivery session
+	void sampleResources();
+	void replayEvents();
 
 public:
 	WebRTCClient(const std::string &id);
+	~WebRTCClient();
+
+	const std::string& getClientId() const { return client_id; }
+
+	// Must be set before the first peer connection is created
+	void setTransportProfile(const TransportProfile& profile);
+	const TransportProfile& getTransportProfile() const { return transport; }
 
-	void setupPeerConnection(const std::string& peer_id);
+	// Benchmarking: rewrite remote candidates so peer traffic crosses the relay
+	void setImpairmentRelay(std::shared_ptr<ImpairmentRelay> relay) { impairment = std::move(relay); }
+	const ImpairmentRelay* getImpairmentRelay() const { return impairment.get(); }
+
+#ifdef CLIENT_BENCHMARK_HOOKS
+	// Benchmark builds only (tools/ui_bench): fake roster, chat history and connected peers (no sockets, no peer connections)
+	void loadSyntheticState(size_t roster, size_t history_lines, size_t connected_peers);
+#endif
+
+	std::shared_ptr<rtc::PeerConnection> setupPeerConnection(const std::string& peer_id); // Returns the pc it put in the map
 
 	void setupDataChannel(const std::string& peer_id, std::shared_ptr<rtc::DataChannel> channel);
 
 	bool connectToSignalingServer(const std::string &url);
 
-	void handleSignalingMessage(const std::string &message);
+	// Find peers by multicast beacon and signal them directly instead of through the server
+	bool startLanDiscovery();
+	bool isLanDiscovery() const { return lan != nullptr; }
+	LanDiscoveryStats getLanDiscoveryStats() const;
+
+	void handleSignalingMessage(std::string message); // By value: parsed in place
 	void createOffer(const std::string& peer_id);
-	void sendMessage(const std::string &msg, const std::string& peer_id = ""); // empty = broadcast to all
-	const std::vector<std::string>& getMessageHistory() const;
+	// Empty peer_id = broadcast to all. False if nothing was sent: no such peer, or a peer
+	// has too much unacknowledged (backpressure - the message is not queued, retry later)
+	bool sendMessage(const std::string &msg, const std::string& peer_id = "");
+	// Calls visit with the history locked; visit must not call back into the client
+	void visitMessageHistory(const std::function<void(const std::vector<ChatMessage>&)>& visit) const;
 	const std::vector<std::string>& getConnectedClients() const;
 	std::vector<std::string> getConnectedPeerIds() const;
 	bool isConnectedToPeer(const std::string& peer_id) const;
+	DeliveryStats getDeliveryStats(const std::string& peer_id) const;
+	double getGatheringTime(const std::string& peer_id) const; // ms, -1 if unknown
+	size_t getBufferedAmount(const std::string& peer_id) const; // Bytes queued in the data channel
+
+	// Route signaling over established data channels where possible
+	void setMeshSignaling(bool enabled);
+	bool isMeshSignaling() const;
+	SignalingRouteStats getSignalingRouteStats() const;
+
+	// Pack bursts of small messages into one data-channel message per peer
+	void setCoalescingEnabled(bool enabled);
+	bool isCoalescingEnabled() const;
+	CoalescingStats getCoalescingStats() const;
+
+	LatencyReport getLatencyReport(const std::string& peer_id) const;
+
+	// Bytes spent reconciling public history against its size and the divergence found
+	HistorySyncStats getHistorySyncStats() const;
+
+	// Media tracks: .h264 (Annex-B) or .ogg (Opus) clips, looped to all connected peers
+	bool startMediaStream(const std::string& path, double video_fps = 30.0);
+	void stopMediaStreams();
+	std::vector<MediaStreamStats> getMediaStats() const;
+	uint64_t getMediaPacketsReceived() const { return media_packets_received.load(); }
+
+	// Close peers that exchanged no chat messages for 'idle' (0 disables); they
+	// reconnect transparently when either side sends to them
+	void setHibernateAfter(std::chrono::seconds idle);
+	std::chrono::seconds getHibernateAfter() const;
+	bool isHibernated(const std::string& peer_id) const;
+	HibernationStats getHibernationStats() const;
+
+	// Memory, descriptors and wakeups of the whole process next to the peer count
+	ResourceReport getResourceReport() const;
+
+	// Capture inbound signaling and data-channel events to a trace file
+	bool startRecording(const std::string& path);
+	void stopRecording();
+	bool isRecording() const { return recorder.isOpen(); }
+	uint64_t getRecordedEvents() const { return recorder.eventCount(); }
+
+	// Feed a recorded trace back in from update() instead of talking to the network.
+	// Call before connecting; speed scales the recorded timing (0 = as fast as possible).
+	bool startReplay(const std::string& path, double speed = 1.0);
+	bool isReplaying() const { return replayer != nullptr; }
+	ReplayProgress getReplayProgress() const;
+
+	// Periodic housekeeping (replay, LAN roster, handshakes, media tracks, hibernation, batch flushes, delayed acks, latency probes), called once per UI frame
+	void update();
 	
 	// Connection request methods
 	void sendConnectionRequest(const std::string& targetClientId);
 	void sendConnectionResponse(const std::string& targetClientId, bool accepted);
 	void disconnectFromPeer(const std::string& peer_id);
+
+	// Scheduled handshakes: requests go out as slots free up (see HandshakeScheduler)
+	void connectToPeer(const std::string& peer_id);
+	void connectToAll(); // Every listed client we are not connected to yet
+	bool isHandshakePending(const std::string& peer_id) const;
+	void acceptConnectionRequest(const std::string& peer_id);
+	void rejectConnectionRequest(const std::string& peer_id);
+	std::vector<IncomingRequest> getPendingRequests() const;
+	void setAutoAcceptPolicy(AutoAcceptPolicy policy);
+	AutoAcceptPolicy getAutoAcceptPolicy() const;
+	void setMaxConcurrentHandshakes(size_t limit);
+	size_t getMaxConcurrentHandshakes() const;
+	HandshakeStats getHandshakeStats() const;
 	
-	// Callback for connection requests - to be set by App
+	// Notification for connection requests; the request itself waits in the handshake queue
 	std::function<void(const std::string& fromClientId, const std::string& fromClientName)> onConnectionRequest;
 	std::function<void(const std::string& fromClientId, bool accepted)> onConnectionResponse;
 };
\ No newline at end of file
@@ -0,0 +1,425 @@
+#include "ClientWindow.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+ClientWindow::ClientWindow(WebRTCClient &client) : m_client(client)
+{
+}
+
+bool ClientWindow::sectionHeader(const char *label)
+{
+	if (m_expand_sections)
+	{
+		ImGui::SetNextItemOpen(true);
+	}
+	return ImGui::CollapsingHeader(label);
+}
+
+void ClientWindow::draw()
+{
+	ImGui::Begin("WebRTC Client");
+	ImGui::Text("Your ID: %s", m_client.getClientId().c_str());
+	ImGui::SameLine();
+	if (ImGui::Button("Copy##CopyID"))
+	{
+		ImGui::SetClipboardText(m_client.getClientId().c_str());
+	}
+	ImGui::SameLine();
+	ImGui::TextDisabled("Transport: %s", m_client.getTransportProfile().name.c_str());
+	if (m_client.isLanDiscovery())
+	{
+		LanDiscoveryStats discovery = m_client.getLanDiscoveryStats();
+		ImGui::SameLine();
+		ImGui::TextDisabled("| LAN discovery: %zu peers, %llu beacons in, %llu messages in / %llu out (%llu resent, %llu unacked)",
+							discovery.peers, (unsigned long long)discovery.beacons_received,
+							(unsigned long long)discovery.messages_received, (unsigned long long)discovery.messages_sent,
+							(unsigned long long)discovery.retransmits, (unsigned long long)discovery.unacked);
+	}
+	if (m_client.isReplaying())
+	{
+		ReplayProgress replay = m_client.getReplayProgress();
+		ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.2f, 1.0f), "Replay %s: %zu/%zu events, %.1f ms handling",
+						   replay.finished ? "done" : "running", replay.position, replay.total, replay.handling_ms);
+		ImGui::SameLine();
+		if (replay.speed > 0.0)
+			ImGui::TextDisabled("(%.1fx)", replay.speed);
+		else
+			ImGui::TextDisabled("(full speed)");
+	}
+	if (m_client.isRecording())
+	{
+		ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Recording session: %llu events", static_cast<unsigned long long>(m_client.getRecordedEvents()));
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Stop##StopRecording"))
+			m_client.stopRecording();
+	}
+	ImGui::Separator();
+	
+	// Active users section
+	auto connected_peers = m_client.getConnectedPeerIds();
+	ImGui::Text("Online Users (%zu) | Connected (%zu):", m_client.getConnectedClients().size(), connected_peers.size());
+	
+	if (!connected_peers.empty()) {
+		ImGui::SameLine();
+		ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "• %zu active connections", connected_peers.size());
+	}
+	
+	ImGui::BeginChild("ActiveUsers", ImVec2(0, 120), true);
+	// Only the visible rows are laid out; every row is one line high
+	const auto &clients = m_client.getConnectedClients();
+	ImGuiListClipper roster_clipper;
+	roster_clipper.Begin(static_cast<int>(clients.size()));
+	while (roster_clipper.Step())
+	{
+		for (int row = roster_clipper.DisplayStart; row < roster_clipper.DisplayEnd; row++)
+		{
+			const std::string &clientId = clients[row];
+			bool isConnected = m_client.isConnectedToPeer(clientId);
+		
+			// Show connection status with color coding
+			if (isConnected)
+			{
+				ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "★ %s (Connected)", clientId.c_str());
+			}
+			else if (m_client.isHibernated(clientId))
+			{
+				ImGui::TextColored(ImVec4(0.4f, 0.6f, 1.0f, 1.0f), "☾ %s (Hibernated)", clientId.c_str());
+			}
+			else
+			{
+				ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "• %s (Online)", clientId.c_str());
+			}
+		
+			ImGui::SameLine();
+			if (ImGui::SmallButton(("Copy##" + clientId).c_str()))
+			{
+				ImGui::SetClipboardText(clientId.c_str());
+			}
+		
+			if (!isConnected && m_client.isHandshakePending(clientId))
+			{
+				ImGui::SameLine();
+				ImGui::TextDisabled("(connecting...)");
+			}
+			else if (!isConnected)
+			{
+				ImGui::SameLine();
+				if (ImGui::SmallButton(("Connect##" + clientId).c_str()))
+				{
+					// FLOW STEP 2: User clicks "Connect" - we queue a connection request
+					// Once a handshake slot is free this sends JSON: {"type":"connection-request","from":"us","to":"them"}
+					m_client.connectToPeer(clientId);
+				}
+			}
+			else
+			{
+				ImGui::SameLine();
+				ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "✓ Connected");
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::SetTooltip("ICE gathering: %.1f ms", m_client.getGatheringTime(clientId));
+				}
+				DeliveryStats delivery = m_client.getDeliveryStats(clientId);
+				if (delivery.buffered_messages > 0)
+				{
+					ImGui::SameLine();
+					ImGui::TextDisabled("(%zu unacked)", delivery.buffered_messages);
+				}
+				ImGui::SameLine();
+				ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.2f, 0.2f, 1.0f));
+				ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.9f, 0.3f, 0.3f, 1.0f));
+				ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.7f, 0.1f, 0.1f, 1.0f));
+				if (ImGui::SmallButton(("Disconnect##" + clientId).c_str()))
+				{
+					m_client.disconnectFromPeer(clientId);
+				}
+				ImGui::PopStyleColor(3);
+			}
+		}
+	}
+	if (m_client.getConnectedClients().empty())
+	{
+		ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "No other users online");
+	}
+	ImGui::EndChild();
+	
+	ImGui::Separator();
+	
+	// Manual connection section
+	ImGui::Text("Manual Connect:");
+	ImGui::InputText("Client ID", m_target_id, sizeof(m_target_id));
+	ImGui::SameLine();
+	if (ImGui::Button("Request Connection") && strlen(m_target_id) > 0)
+	{
+		m_client.connectToPeer(m_target_id);
+	}
+
+	// Bulk connect, a few negotiations at a time
+	if (ImGui::Button("Connect to all"))
+	{
+		m_client.connectToAll();
+	}
+	ImGui::SameLine();
+	int max_handshakes = (int)m_client.getMaxConcurrentHandshakes();
+	ImGui::SetNextItemWidth(120);
+	if (ImGui::SliderInt("in flight", &max_handshakes, 1, 64))
+	{
+		m_client.setMaxConcurrentHandshakes((size_t)max_handshakes);
+	}
+	ImGui::SameLine();
+	const char *policies[] = {"manual", "known", "all", "none"};
+	int policy = (int)m_client.getAutoAcceptPolicy();
+	ImGui::SetNextItemWidth(90);
+	if (ImGui::Combo("auto-accept", &policy, policies, IM_ARRAYSIZE(policies)))
+	{
+		m_client.setAutoAcceptPolicy((AutoAcceptPolicy)policy);
+	}
+
+	HandshakeStats handshakes = m_client.getHandshakeStats();
+	if (handshakes.started > 0 && sectionHeader("Handshakes"))
+	{
+		ImGui::Text("%zu in flight (peak %zu), %zu incoming / %zu outgoing queued",
+					handshakes.in_flight, handshakes.peak_in_flight, handshakes.queued_incoming, handshakes.queued_outgoing);
+		ImGui::Text("%llu started, %llu connected, %llu failed, %llu timed out, %llu rejected (%.0f%% completed)",
+					(unsigned long long)handshakes.started, (unsigned long long)handshakes.completed,
+					(unsigned long long)handshakes.failed, (unsigned long long)handshakes.timed_out,
+					(unsigned long long)handshakes.rejected, handshakes.completionRate() * 100.0);
+		if (handshakes.glare > 0)
+		{
+			ImGui::Text("%llu simultaneous connects settled by client id", (unsigned long long)handshakes.glare);
+		}
+		ImGui::Text("queue wait p50 %.1f ms, p99 %.1f ms", handshakes.queue_wait.percentile(50), handshakes.queue_wait.percentile(99));
+		ImGui::Text("handshake p50 %.1f ms, p99 %.1f ms, burst %.1f/s", handshakes.handshake_time.percentile(50),
+					handshakes.handshake_time.percentile(99), handshakes.handshakesPerSecond());
+	}
+
+	// Idle-peer hibernation and what the mesh costs the process
+	if (sectionHeader("Resources"))
+	{
+		int idle_seconds = static_cast<int>(m_client.getHibernateAfter().count());
+		ImGui::SetNextItemWidth(120.0f);
+		if (ImGui::InputInt("Hibernate idle peers after (s, 0 = never)", &idle_seconds))
+		{
+			m_client.setHibernateAfter(std::chrono::seconds(idle_seconds > 0 ? idle_seconds : 0));
+		}
+		HibernationStats hibernation = m_client.getHibernationStats();
+		ImGui::Text("%zu hibernated, %llu hibernations, %llu resumed", hibernation.hibernated,
+					(unsigned long long)hibernation.hibernations, (unsigned long long)hibernation.resumes);
+
+		ResourceReport report = m_client.getResourceReport();
+		auto showReport = [](const char *label, const ResourceReport &r)
+		{
+			ImGui::Text("%s: %zu live / %zu hibernated peers, RSS %.1f MB, %zu fds, %zu threads, %.0f wakeups/s", label,
+						r.live_peers, r.hibernated_peers, r.process.rss_bytes / (1024.0 * 1024.0), r.process.open_fds,
+						r.process.threads, r.wakeups_per_sec);
+			ImGui::TextDisabled("    per 100 peers: %.1f MB, %.0f fds, %.0f wakeups/s", r.per100Peers(r.process.rss_bytes / (1024.0 * 1024.0)),
+								r.per100Peers(static_cast<double>(r.process.open_fds)), r.per100Peers(r.wakeups_per_sec));
+		};
+		showReport("Now", report);
+		if (m_resource_baseline)
+		{
+			showReport("Before", *m_resource_baseline);
+		}
+		if (ImGui::SmallButton("Mark as before"))
+		{
+			m_resource_baseline = report;
+		}
+	}
+
+	// Signaling routes: how much still goes through the server
+	bool mesh = m_client.isMeshSignaling();
+	if (ImGui::Checkbox("Mesh signaling", &mesh))
+	{
+		m_client.setMeshSignaling(mesh);
+	}
+	SignalingRouteStats routes = m_client.getSignalingRouteStats();
+	ImGui::SameLine();
+	ImGui::TextDisabled("sent %llu server / %llu lan / %llu direct / %llu relayed (%.0f%% server, %llu vs %llu bytes), forwarded %llu",
+						(unsigned long long)routes.websocket, (unsigned long long)routes.lan, (unsigned long long)routes.direct,
+						(unsigned long long)routes.relayed, routes.websocketShare() * 100.0,
+						(unsigned long long)routes.websocket_bytes, (unsigned long long)routes.mesh_bytes,
+						(unsigned long long)routes.forwarded);
+	
+	ImGui::Separator();
+	
+	// Message section
+	ImGui::Text("Send Message:");
+	ImGui::SameLine();
+	bool coalescing = m_client.isCoalescingEnabled();
+	if (ImGui::Checkbox("Coalesce bursts", &coalescing))
+	{
+		m_client.setCoalescingEnabled(coalescing);
+	}
+	if (coalescing)
+	{
+		CoalescingStats batching = m_client.getCoalescingStats();
+		ImGui::SameLine();
+		ImGui::TextDisabled("%.2f frames/message (%llu frames)", batching.batchingFactor(), (unsigned long long)batching.frames);
+	}
+	ImGui::InputText("Message", m_message, sizeof(m_message));
+	
+	// Send options. A refused send (peer not keeping up) leaves the text in place to retry.
+	if (ImGui::Button("Broadcast to All") && strlen(m_message) > 0)
+	{
+		if (m_client.sendMessage(m_message)) // Empty peer_id = broadcast
+			memset(m_message, 0, sizeof(m_message));
+	}
+	
+	// Send to specific peers
+	auto connected_peers_list = m_client.getConnectedPeerIds();
+	if (!connected_peers_list.empty()) {
+		ImGui::SameLine();
+		ImGui::Text("or send to:");
+		for (const auto& peer_id : connected_peers_list) {
+			ImGui::SameLine();
+			if (ImGui::SmallButton((peer_id + "##send").c_str()) && strlen(m_message) > 0) {
+				if (m_client.sendMessage(m_message, peer_id))
+					memset(m_message, 0, sizeof(m_message));
+			}
+		}
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Message History:");
+	HistorySyncStats sync = m_client.getHistorySyncStats();
+	if (sync.rounds > 0 || sync.items_received > 0)
+	{
+		ImGui::SameLine();
+		ImGui::TextDisabled("%zu public (%.1f KB), sync fetched %llu / sent %llu, %.1f KB exchanged in %llu rounds",
+							sync.items, sync.history_bytes / 1024.0, (unsigned long long)sync.items_received,
+							(unsigned long long)sync.items_sent, (sync.bytes_sent + sync.bytes_received) / 1024.0,
+							(unsigned long long)sync.rounds);
+	}
+	ImGui::BeginChild("MessageHistory", ImVec2(0, 180), true, ImGuiWindowFlags_HorizontalScrollbar);
+	// Drawn with the history locked: lines are inserted from the channel threads.
+	// One unwrapped line per message, so the clipper can skip straight to the visible
+	// rows; long lines scroll sideways.
+	auto drawHistory = [](const std::vector<ChatMessage> &history)
+	{
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(history.size()));
+		while (clipper.Step())
+		{
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+			{
+				const ChatMessage &msg = history[row];
+				if (msg.synced)
+					ImGui::TextDisabled("%s", msg.text.c_str());
+				else if (msg.latency_ms >= 0.0)
+					ImGui::Text("%s  (%.1f ms)", msg.text.c_str(), msg.latency_ms);
+				else
+					ImGui::Text("%s", msg.text.c_str());
+			}
+		}
+	};
+	m_client.visitMessageHistory(drawHistory);
+	ImGui::EndChild();
+
+	// Per-peer latency from the ping/pong probes
+	if (!connected_peers_list.empty() && sectionHeader("Latency"))
+	{
+		if (const ImpairmentRelay *relay = m_client.getImpairmentRelay())
+		{
+			ImpairmentRelay::Stats impaired = relay->stats();
+			ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "Impaired: %s", relay->config().describe().c_str());
+			ImGui::Text("  relay: %llu forwarded, %llu lost, %llu queue drops, %llu reordered",
+						(unsigned long long)impaired.forwarded, (unsigned long long)impaired.dropped_loss,
+						(unsigned long long)impaired.dropped_queue, (unsigned long long)impaired.reordered);
+		}
+
+		for (const auto &peer_id : connected_peers_list)
+		{
+			LatencyReport latency = m_client.getLatencyReport(peer_id);
+			ImGui::Text("%s: rtt %.1f ms, clock offset %+.1f ms, %zu bytes buffered", peer_id.c_str(), latency.rtt_ms,
+						latency.offset_ms, m_client.getBufferedAmount(peer_id));
+			ImGui::Text("  rtt p50/p99 %.1f/%.1f ms | one-way p50/p90/p99 %.1f/%.1f/%.1f ms (%llu msgs)",
+						latency.rtt.percentile(50), latency.rtt.percentile(99),
+						latency.one_way.percentile(50), latency.one_way.percentile(90), latency.one_way.percentile(99),
+						(unsigned long long)latency.one_way.count());
+
+			float buckets[LatencyHistogram::BUCKETS];
+			for (int i = 0; i < LatencyHistogram::BUCKETS; i++)
+				buckets[i] = (float)latency.one_way.buckets()[i];
+			ImGui::PlotHistogram(("##latency" + peer_id).c_str(), buckets, LatencyHistogram::BUCKETS, 0,
+								 "one-way latency (50us .. 50s, log scale)", 0.0f, FLT_MAX, ImVec2(0, 60));
+		}
+	}
+
+	// Pre-encoded media tracks
+	if (sectionHeader("Media"))
+	{
+		ImGui::InputText("File (.h264/.ogg)", m_media_path, sizeof(m_media_path));
+		ImGui::SameLine();
+		if (ImGui::Button("Stream") && strlen(m_media_path) > 0)
+		{
+			m_client.startMediaStream(m_media_path);
+		}
+
+		std::vector<MediaStreamStats> streams = m_client.getMediaStats();
+		for (const auto &stream : streams)
+		{
+			ImGui::Text("%s (%s): %zu peers, %.0f pkt/s, %.1f%% CPU, %llu frames, loop %llu", stream.name.c_str(),
+						stream.mid.c_str(), stream.peers, stream.packets_per_sec, stream.cpu_percent,
+						(unsigned long long)stream.frames_sent, (unsigned long long)stream.loops);
+		}
+		if (!streams.empty() && ImGui::Button("Stop streams"))
+		{
+			m_client.stopMediaStreams();
+		}
+		ImGui::TextDisabled("%llu media packets received", (unsigned long long)m_client.getMediaPacketsReceived());
+	}
+	ImGui::End();
+
+	// Connection request popup: one queued request at a time, oldest first
+	std::vector<IncomingRequest> requests = m_client.getPendingRequests();
+	auto manual = std::find_if(requests.begin(), requests.end(), [](const IncomingRequest &request)
+							   { return !request.auto_accept; });
+	size_t waiting = std::count_if(requests.begin(), requests.end(), [](const IncomingRequest &request)
+								   { return !request.auto_accept; });
+	if (manual != requests.end() && !ImGui::IsPopupOpen("Connection Request"))
+	{
+		ImGui::OpenPopup("Connection Request");
+	}
+
+	if (ImGui::BeginPopupModal("Connection Request", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+	{
+		if (manual == requests.end())
+		{
+			ImGui::CloseCurrentPopup();
+		}
+		else
+		{
+			ImGui::Text("User '%s' wants to connect with you.", manual->name.c_str());
+			ImGui::Text("Do you want to accept this connection?");
+			if (waiting > 1)
+			{
+				ImGui::TextDisabled("%zu more requests waiting", waiting - 1);
+			}
+			ImGui::Separator();
+
+			if (ImGui::Button("Accept"))
+			{
+				// FLOW STEP 3: User accepts connection request
+				// Sends JSON: {"type":"connection-response","data":{"accepted":true}}
+				m_client.acceptConnectionRequest(manual->peer_id);
+				ImGui::CloseCurrentPopup();
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Reject"))
+			{
+				// FLOW STEP 3 (Alternative): User rejects connection request
+				// Sends JSON: {"type":"connection-response","data":{"accepted":false}}
+				m_client.rejectConnectionRequest(manual->peer_id);
+				ImGui::CloseCurrentPopup();
+			}
+		}
+
+		ImGui::EndPopup();
+	}
+
+	m_expand_sections = false;
+}
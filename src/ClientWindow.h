@@ -0,0 +1,32 @@
+#pragma once
+
+#include <optional>
+
+#include "Client.h"
+
+// The "WebRTC Client" window and the connection-request popup.
+//
+// Only talks to ImGui and the client, so it can be driven without a platform
+// or renderer backend (see tools/ui_bench).
+class ClientWindow
+{
+public:
+	ClientWindow(WebRTCClient& client);
+
+	// Builds the widgets for this frame; call between ImGui::NewFrame() and ImGui::Render()
+	void draw();
+
+	// Open the collapsible sections (handshakes, resources, latency, media) on the next frame
+	void expandSections() { m_expand_sections = true; }
+
+private:
+	bool sectionHeader(const char* label);
+
+	WebRTCClient& m_client;
+
+	char m_target_id[256] = {};
+	char m_message[1024] = {};
+	char m_media_path[512] = {};
+	bool m_expand_sections = false;
+	std::optional<ResourceReport> m_resource_baseline; // "Before" figures for the Resources panel
+};
@@ -0,0 +1,271 @@
+#include "HandshakeScheduler.h"
+
+#include <algorithm>
+#include <iostream>
+
+const char *autoAcceptPolicyName(AutoAcceptPolicy policy)
+{
+	switch (policy)
+	{
+	case AutoAcceptPolicy::Manual:
+		return "manual";
+	case AutoAcceptPolicy::AcceptKnown:
+		return "known";
+	case AutoAcceptPolicy::AcceptAll:
+		return "all";
+	case AutoAcceptPolicy::RejectAll:
+		return "none";
+	}
+	return "manual";
+}
+
+std::optional<AutoAcceptPolicy> parseAutoAcceptPolicy(const std::string &name)
+{
+	for (AutoAcceptPolicy policy : {AutoAcceptPolicy::Manual, AutoAcceptPolicy::AcceptKnown, AutoAcceptPolicy::AcceptAll, AutoAcceptPolicy::RejectAll})
+	{
+		if (name == autoAcceptPolicyName(policy))
+		{
+			return policy;
+		}
+	}
+	return std::nullopt;
+}
+
+static double elapsedMs(HandshakeScheduler::Clock::time_point from, HandshakeScheduler::Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+HandshakeScheduler::HandshakeScheduler(size_t max_in_flight, Clock::duration timeout)
+	: max_in_flight(max_in_flight > 0 ? max_in_flight : 1), timeout(timeout)
+{
+}
+
+void HandshakeScheduler::onIncomingRequest(const std::string &peer_id, const std::string &name, bool known, Clock::time_point now, bool resume)
+{
+	if (in_flight.count(peer_id))
+	{
+		// Both sides asked at once. The lower id's request wins on both ends.
+		counters.glare++;
+		if (local_id < peer_id)
+		{
+			std::cout << "Ignoring connection request from " << peer_id << " - our simultaneous request wins" << std::endl;
+		}
+		else
+		{
+			// Our request is dropped (the peer ignores it); the slot now serves theirs
+			std::cout << "Simultaneous connect with " << peer_id << " - accepting their request instead of ours" << std::endl;
+			ready.push_back({Action::Kind::Accept, peer_id});
+		}
+		return;
+	}
+
+	auto queued = std::find_if(incoming.begin(), incoming.end(), [&](const IncomingRequest &request)
+							   { return request.peer_id == peer_id; });
+	if (queued != incoming.end())
+	{
+		return;
+	}
+
+	// We meant to connect anyway: answer their request rather than send ours
+	auto ours = std::find_if(outgoing.begin(), outgoing.end(), [&](const Outgoing &request)
+							 { return request.peer_id == peer_id; });
+	if (ours != outgoing.end())
+	{
+		outgoing.erase(ours);
+		incoming.push_back({peer_id, name, now, true});
+		return;
+	}
+
+	if (policy == AutoAcceptPolicy::RejectAll && !resume)
+	{
+		counters.rejected++;
+		ready.push_back({Action::Kind::Reject, peer_id});
+		return;
+	}
+
+	bool auto_accept = resume || policy == AutoAcceptPolicy::AcceptAll || (policy == AutoAcceptPolicy::AcceptKnown && known);
+	incoming.push_back({peer_id, name, now, auto_accept});
+}
+
+void HandshakeScheduler::resolve(const std::string &peer_id, bool accept, Clock::time_point now)
+{
+	auto it = std::find_if(incoming.begin(), incoming.end(), [&](const IncomingRequest &request)
+						   { return request.peer_id == peer_id; });
+	if (it == incoming.end())
+	{
+		return;
+	}
+
+	Clock::time_point received = it->received;
+	incoming.erase(it);
+
+	if (accept)
+	{
+		// The user asked for it explicitly, so it may exceed the limit
+		start(peer_id, received, now);
+		ready.push_back({Action::Kind::Accept, peer_id});
+	}
+	else
+	{
+		counters.rejected++;
+		ready.push_back({Action::Kind::Reject, peer_id});
+	}
+}
+
+void HandshakeScheduler::connectTo(const std::string &peer_id, Clock::time_point now)
+{
+	auto theirs = std::find_if(incoming.begin(), incoming.end(), [&](const IncomingRequest &request)
+							   { return request.peer_id == peer_id; });
+	if (theirs != incoming.end())
+	{
+		theirs->auto_accept = true;
+		return;
+	}
+
+	if (!isBusy(peer_id))
+	{
+		outgoing.push_back({peer_id, now});
+	}
+}
+
+void HandshakeScheduler::onConnected(const std::string &peer_id, Clock::time_point now)
+{
+	auto it = in_flight.find(peer_id);
+	if (it == in_flight.end())
+	{
+		return;
+	}
+
+	counters.handshake_time.add(elapsedMs(it->second, now));
+	counters.completed++;
+	counters.burst_completed++;
+	finish(peer_id, now);
+}
+
+void HandshakeScheduler::onFailed(const std::string &peer_id, Clock::time_point now)
+{
+	if (in_flight.count(peer_id))
+	{
+		counters.failed++;
+		finish(peer_id, now);
+	}
+}
+
+void HandshakeScheduler::forget(const std::string &peer_id)
+{
+	in_flight.erase(peer_id);
+	incoming.erase(std::remove_if(incoming.begin(), incoming.end(), [&](const IncomingRequest &request)
+								  { return request.peer_id == peer_id; }),
+				   incoming.end());
+	outgoing.erase(std::remove_if(outgoing.begin(), outgoing.end(), [&](const Outgoing &request)
+								  { return request.peer_id == peer_id; }),
+				   outgoing.end());
+}
+
+bool HandshakeScheduler::isBusy(const std::string &peer_id) const
+{
+	if (in_flight.count(peer_id))
+	{
+		return true;
+	}
+	for (const auto &request : incoming)
+	{
+		if (request.peer_id == peer_id)
+			return true;
+	}
+	for (const auto &request : outgoing)
+	{
+		if (request.peer_id == peer_id)
+			return true;
+	}
+	return false;
+}
+
+std::vector<HandshakeScheduler::Action> HandshakeScheduler::poll(Clock::time_point now)
+{
+	std::vector<Action> actions;
+	actions.swap(ready);
+
+	std::vector<std::string> expired;
+	for (const auto &[peer_id, started] : in_flight)
+	{
+		if (now - started >= timeout)
+		{
+			expired.push_back(peer_id);
+		}
+	}
+	for (const auto &peer_id : expired)
+	{
+		counters.timed_out++;
+		actions.push_back({Action::Kind::Abort, peer_id});
+		finish(peer_id, now);
+	}
+
+	// Peers already waiting on us go first, then our own requests
+	while (in_flight.size() < max_in_flight)
+	{
+		auto accepted = std::find_if(incoming.begin(), incoming.end(), [](const IncomingRequest &request)
+									 { return request.auto_accept; });
+		if (accepted != incoming.end())
+		{
+			std::string peer_id = accepted->peer_id;
+			Clock::time_point received = accepted->received;
+			incoming.erase(accepted);
+			start(peer_id, received, now);
+			actions.push_back({Action::Kind::Accept, peer_id});
+		}
+		else if (!outgoing.empty())
+		{
+			Outgoing request = outgoing.front();
+			outgoing.pop_front();
+			start(request.peer_id, request.queued, now);
+			actions.push_back({Action::Kind::SendRequest, request.peer_id});
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return actions;
+}
+
+HandshakeStats HandshakeScheduler::stats() const
+{
+	HandshakeStats result = counters;
+	result.queued_incoming = incoming.size();
+	result.queued_outgoing = outgoing.size();
+	result.in_flight = in_flight.size();
+	return result;
+}
+
+void HandshakeScheduler::start(const std::string &peer_id, Clock::time_point queued, Clock::time_point now)
+{
+	// A burst starts when nothing was in flight; its rate covers every handshake until it drains
+	if (in_flight.empty())
+	{
+		burst_start = now;
+		counters.burst_completed = 0;
+		counters.burst_seconds = 0.0;
+	}
+
+	in_flight[peer_id] = now;
+	counters.started++;
+	counters.queue_wait.add(elapsedMs(queued, now));
+	counters.peak_in_flight = std::max(counters.peak_in_flight, in_flight.size());
+}
+
+void HandshakeScheduler::finish(const std::string &peer_id, Clock::time_point now)
+{
+	in_flight.erase(peer_id);
+	counters.burst_seconds = elapsedMs(burst_start, now) / 1000.0;
+
+	if (in_flight.empty() && incoming.empty() && outgoing.empty() && counters.burst_completed > 1)
+	{
+		std::cout << "Handshake burst done: " << counters.burst_completed << " connected in " << counters.burst_seconds
+				  << " s, queue wait p50 " << counters.queue_wait.percentile(50) << " ms / p99 "
+				  << counters.queue_wait.percentile(99) << " ms, handshake p50 " << counters.handshake_time.percentile(50)
+				  << " ms / p99 " << counters.handshake_time.percentile(99) << " ms" << std::endl;
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "LatencyProbe.h"
+
+// What to do with incoming connection requests without asking the user
+enum class AutoAcceptPolicy
+{
+	Manual,		 // Queue every request for the user
+	AcceptKnown, // Accept peers we already have a delivery session with, queue the rest
+	AcceptAll,
+	RejectAll
+};
+
+const char *autoAcceptPolicyName(AutoAcceptPolicy policy);
+std::optional<AutoAcceptPolicy> parseAutoAcceptPolicy(const std::string &name);
+
+// A connection request waiting for a decision
+struct IncomingRequest
+{
+	std::string peer_id;
+	std::string name;
+	std::chrono::steady_clock::time_point received;
+	bool auto_accept = false; // Policy accepts it once a handshake slot is free
+};
+
+struct HandshakeStats
+{
+	size_t queued_incoming = 0; // Waiting for the user or for a free slot
+	size_t queued_outgoing = 0; // connectTo calls not yet sent
+	size_t in_flight = 0;
+	size_t peak_in_flight = 0;
+
+	uint64_t started = 0;
+	uint64_t completed = 0;
+	uint64_t failed = 0;	// Rejected by the peer or the connection failed
+	uint64_t timed_out = 0;
+	uint64_t rejected = 0;	// Incoming requests we turned down
+	uint64_t glare = 0;		// Both sides requested at once, settled by the tie-break
+
+	LatencyHistogram queue_wait;	 // Request queued -> handshake started
+	LatencyHistogram handshake_time; // Handshake started -> connected
+
+	double burst_seconds = 0.0; // First start to last finish of the current/last burst
+	uint64_t burst_completed = 0;
+
+	double completionRate() const
+	{
+		uint64_t finished = completed + failed + timed_out;
+		return finished ? static_cast<double>(completed) / static_cast<double>(finished) : 0.0;
+	}
+	double handshakesPerSecond() const { return burst_seconds > 0.0 ? burst_completed / burst_seconds : 0.0; }
+};
+
+// Bounds the number of concurrent WebRTC handshakes (DTLS + ICE are CPU heavy)
+// and queues everything else: incoming requests waiting for the user or for a
+// slot, and outgoing requests from connectToAll. A handshake holds its slot
+// from the request (or our acceptance) until the peer connection is up, fails
+// or times out.
+//
+// Pure bookkeeping: poll() hands back the actions to perform, the caller
+// does the signaling.
+//
+// Simultaneous connects (both sides sent a request) are settled without
+// another round trip: the request from the lower client id wins. The higher
+// side accepts it in the slot its own request held and never hears back
+// about its own; the lower side ignores the losing request.
+class HandshakeScheduler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Action
+	{
+		enum class Kind
+		{
+			SendRequest, // connection-request to peer_id
+			Accept,		 // connection-response accepted
+			Reject,		 // connection-response rejected
+			Abort		 // Timed out: tear down the half-open connection
+		};
+		Kind kind;
+		std::string peer_id;
+	};
+
+	HandshakeScheduler(size_t max_in_flight = 8, Clock::duration timeout = std::chrono::seconds(20));
+
+	// Our client id, for the simultaneous-connect tie-break
+	void setLocalId(const std::string &id) { local_id = id; }
+
+	void setMaxInFlight(size_t limit) { max_in_flight = limit > 0 ? limit : 1; }
+	size_t maxInFlight() const { return max_in_flight; }
+	void setPolicy(AutoAcceptPolicy new_policy) { policy = new_policy; }
+	AutoAcceptPolicy getPolicy() const { return policy; }
+
+	// Incoming side. 'known' = we talked to this peer before (for AcceptKnown).
+	// 'resume' = a peer we hibernated reconnecting; accepted whatever the policy.
+	void onIncomingRequest(const std::string &peer_id, const std::string &name, bool known, Clock::time_point now, bool resume = false);
+	// User decision on a queued request; an accept starts the handshake at once
+	void resolve(const std::string &peer_id, bool accept, Clock::time_point now);
+	const std::deque<IncomingRequest> &pendingRequests() const { return incoming; }
+
+	// Outgoing side: queued and sent as slots free up. Accepts instead when
+	// the peer's own request is already queued.
+	void connectTo(const std::string &peer_id, Clock::time_point now);
+
+	// Handshake outcome reported by the connection
+	void onConnected(const std::string &peer_id, Clock::time_point now);
+	void onFailed(const std::string &peer_id, Clock::time_point now);
+	void forget(const std::string &peer_id); // Explicit disconnect: drop queued and in-flight state
+
+	bool isBusy(const std::string &peer_id) const; // Queued or in flight
+
+	// Expires timed-out handshakes and fills free slots
+	std::vector<Action> poll(Clock::time_point now);
+
+	HandshakeStats stats() const;
+
+private:
+	struct Outgoing
+	{
+		std::string peer_id;
+		Clock::time_point queued;
+	};
+
+	void start(const std::string &peer_id, Clock::time_point queued, Clock::time_point now);
+	void finish(const std::string &peer_id, Clock::time_point now);
+
+	std::string local_id;
+	size_t max_in_flight;
+	Clock::duration timeout;
+	AutoAcceptPolicy policy = AutoAcceptPolicy::Manual;
+
+	std::deque<IncomingRequest> incoming;
+	std::deque<Outgoing> outgoing;
+	std::unordered_map<std::string, Clock::time_point> in_flight; // peer_id -> handshake start
+	std::vector<Action> ready;									   // Decided outside poll(), returned by the next poll()
+
+	HandshakeStats counters;
+	Clock::time_point burst_start;
+};
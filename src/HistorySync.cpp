@@ -0,0 +1,323 @@
+#include "HistorySync.h"
+#include "JsonFields.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <unordered_set>
+
+using json = nlohmann::json;
+
+static constexpr uint64_t ID_MAX = std::numeric_limits<uint64_t>::max();
+
+// splitmix64 finalizer: spreads ids so sums of different sets rarely collide
+static uint64_t mix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+uint64_t HistorySync::makeId(const std::string &from, int64_t ts_us, const std::string &body)
+{
+	// FNV-1a over sender, timestamp and body
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto feed = [&hash](const void *data, size_t size)
+	{
+		const auto *bytes = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		}
+	};
+	feed(from.data(), from.size());
+	feed(&ts_us, sizeof(ts_us));
+	feed(body.data(), body.size());
+	return mix(hash);
+}
+
+int64_t HistorySync::wallMicros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool HistorySync::add(HistoryItem item)
+{
+	uint64_t id = item.id;
+	size_t bytes = item.body.size();
+	if (!items.emplace(id, std::move(item)).second)
+	{
+		return false;
+	}
+	history_bytes += bytes;
+	return true;
+}
+
+HistorySync::Fingerprint HistorySync::fingerprint(Map::const_iterator first, Map::const_iterator last) const
+{
+	Fingerprint result;
+	for (; first != last; ++first)
+	{
+		result.sum += mix(first->first);
+		result.count++;
+	}
+	return result;
+}
+
+std::string HistorySync::track(std::string frame)
+{
+	counters.bytes_sent += frame.size();
+	return frame;
+}
+
+std::string HistorySync::begin()
+{
+	Fingerprint all = fingerprint(items.begin(), items.end());
+	json frame = {
+		{"type", "sync"},
+		{"ranges", json::array({{{"lo", 0}, {"hi", ID_MAX}, {"fp", all.sum}, {"n", all.count}}})}
+	};
+	return track(frame.dump());
+}
+
+std::vector<std::string> HistorySync::splitFrames(const char *type, const char *key, json entries)
+{
+	// Room for the envelope: type, key and brackets
+	static constexpr size_t FRAME_OVERHEAD = 64;
+
+	std::vector<std::string> frames;
+	json batch = json::array();
+	size_t batch_bytes = FRAME_OVERHEAD;
+	auto flush = [&]()
+	{
+		if (!batch.empty())
+		{
+			json frame = {
+				{"type", type},
+				{key, std::move(batch)}
+			};
+			frames.push_back(track(frame.dump()));
+			batch = json::array();
+			batch_bytes = FRAME_OVERHEAD;
+		}
+	};
+
+	for (auto &entry : entries)
+	{
+		size_t entry_bytes = entry.dump().size() + 1;
+		if (batch_bytes + entry_bytes > MAX_FRAME_BYTES)
+		{
+			flush();
+		}
+		batch.push_back(std::move(entry));
+		batch_bytes += entry_bytes;
+	}
+	flush();
+	return frames;
+}
+
+std::vector<std::string> HistorySync::historyFrames(const std::vector<const HistoryItem *> &send)
+{
+	json entries = json::array();
+	for (const HistoryItem *item : send)
+	{
+		entries.push_back({{"id", item->id}, {"ts", item->ts_us}, {"from", item->from}, {"body", item->body}});
+	}
+	counters.items_sent += send.size();
+	return splitFrames("history", "items", std::move(entries));
+}
+
+std::vector<std::string> HistorySync::onFrame(const json &frame, size_t wire_bytes, std::vector<HistoryItem> &learned, bool &settled)
+{
+	counters.bytes_received += wire_bytes;
+	settled = false;
+	if (!frame.is_object() || !isString(frame, "type"))
+	{
+		return {};
+	}
+	std::string type = frame["type"];
+
+	if (type == "history")
+	{
+		if (!isArray(frame, "items"))
+		{
+			return {};
+		}
+		for (const auto &entry : frame["items"])
+		{
+			if (!entry.is_object() || !isUnsigned(entry, "id") || !isInteger(entry, "ts") ||
+				!isString(entry, "from") || !isString(entry, "body"))
+			{
+				continue;
+			}
+			HistoryItem item{entry["id"].get<uint64_t>(), entry["ts"].get<int64_t>(), entry["from"], entry["body"]};
+			// Ids are derived from the content, so a forged or corrupted item is dropped
+			if (makeId(item.from, item.ts_us, item.body) == item.id && add(item))
+			{
+				counters.items_received++;
+				learned.push_back(std::move(item));
+			}
+		}
+		return {};
+	}
+
+	if (type == "want")
+	{
+		if (!isArray(frame, "ids"))
+		{
+			return {};
+		}
+		std::vector<const HistoryItem *> send;
+		for (const auto &id : frame["ids"])
+		{
+			if (!id.is_number_unsigned())
+			{
+				continue;
+			}
+			auto it = items.find(id.get<uint64_t>());
+			if (it != items.end())
+			{
+				send.push_back(&it->second);
+			}
+		}
+		return historyFrames(send);
+	}
+
+	if (type != "sync" || !isArray(frame, "ranges"))
+	{
+		return {};
+	}
+
+	// The other side found nothing left to compare
+	if (frame["ranges"].empty())
+	{
+		settled = true;
+		return {};
+	}
+
+	// "sync": answer every range
+	counters.rounds++;
+	json ranges = json::array();
+	std::vector<const HistoryItem *> send;
+	json want = json::array();
+
+	for (const auto &range : frame["ranges"])
+	{
+		// A range needs its bounds and either an id list or a fingerprint
+		bool id_list = range.is_object() && isArray(range, "ids");
+		if (!range.is_object() || !isUnsigned(range, "lo") || !isUnsigned(range, "hi") ||
+			(!id_list && (!isUnsigned(range, "fp") || !isUnsigned(range, "n"))))
+		{
+			continue;
+		}
+		uint64_t lo = range["lo"].get<uint64_t>();
+		uint64_t hi = range["hi"].get<uint64_t>();
+		if (lo > hi)
+		{
+			continue;
+		}
+		auto first = items.lower_bound(lo);
+		auto last = hi == ID_MAX ? items.end() : items.upper_bound(hi);
+
+		if (id_list)
+		{
+			// Id list: settles the range both ways
+			std::unordered_set<uint64_t> theirs;
+			for (const auto &id : range["ids"])
+			{
+				if (!id.is_number_unsigned())
+				{
+					continue;
+				}
+				uint64_t value = id.get<uint64_t>();
+				theirs.insert(value);
+				if (!items.count(value))
+				{
+					want.push_back(value);
+				}
+			}
+			for (auto it = first; it != last; ++it)
+			{
+				if (!theirs.count(it->first))
+				{
+					send.push_back(&it->second);
+				}
+			}
+			continue;
+		}
+
+		Fingerprint theirs{range["fp"].get<uint64_t>(), range["n"].get<uint64_t>()};
+		Fingerprint ours = fingerprint(first, last);
+		if (ours == theirs)
+		{
+			continue;
+		}
+
+		if (theirs.count == 0)
+		{
+			// Nothing on their side to compare against
+			for (auto it = first; it != last; ++it)
+			{
+				send.push_back(&it->second);
+			}
+			continue;
+		}
+
+		if (ours.count <= ID_LIST_THRESHOLD)
+		{
+			json ids = json::array();
+			for (auto it = first; it != last; ++it)
+			{
+				ids.push_back(it->first);
+			}
+			ranges.push_back({{"lo", lo}, {"hi", hi}, {"ids", std::move(ids)}});
+			continue;
+		}
+
+		// Split our items in the range into equal-sized buckets; the first starts at lo, the last ends at hi
+		size_t per_bucket = (ours.count + BUCKETS - 1) / BUCKETS;
+		uint64_t bucket_lo = lo;
+		auto it = first;
+		while (it != last)
+		{
+			auto bucket_first = it;
+			std::advance(it, std::min<size_t>(per_bucket, static_cast<size_t>(std::distance(it, last))));
+			uint64_t bucket_hi = it == last ? hi : it->first - 1;
+			Fingerprint part = fingerprint(bucket_first, it);
+			ranges.push_back({{"lo", bucket_lo}, {"hi", bucket_hi}, {"fp", part.sum}, {"n", part.count}});
+			bucket_lo = bucket_hi + 1;
+		}
+	}
+
+	std::vector<std::string> replies = historyFrames(send);
+	for (auto &reply : splitFrames("want", "ids", std::move(want)))
+	{
+		replies.push_back(std::move(reply));
+	}
+	if (ranges.empty())
+	{
+		// Nothing left to compare from our side; the empty sync tells the other side so
+		counters.syncs++;
+		json frame_sync = {
+			{"type", "sync"},
+			{"ranges", json::array()}
+		};
+		replies.push_back(track(frame_sync.dump()));
+	}
+	for (auto &reply : splitFrames("sync", "ranges", std::move(ranges)))
+	{
+		replies.push_back(std::move(reply));
+	}
+	return replies;
+}
+
+HistorySyncStats HistorySync::stats() const
+{
+	HistorySyncStats result = counters;
+	result.items = items.size();
+	result.history_bytes = history_bytes;
+	return result;
+}
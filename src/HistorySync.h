@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <nlohmann/json_fwd.hpp>
+
+// One public chat message as every peer stores it
+struct HistoryItem
+{
+	uint64_t id = 0;	// makeId(from, ts_us, body); the same on every peer
+	int64_t ts_us = 0;	// Sender wall clock (wallMicros), comparable across peers
+	std::string from;
+	std::string body;
+};
+
+struct HistorySyncStats
+{
+	size_t items = 0;		 // History size
+	size_t history_bytes = 0; // Sum of message bodies
+	uint64_t syncs = 0;		 // Reconciliations that reached agreement
+	uint64_t rounds = 0;	 // Sync frames received
+	uint64_t bytes_sent = 0; // Sync, want and history frames
+	uint64_t bytes_received = 0;
+	uint64_t items_sent = 0; // Divergence: messages one side had and the other did not
+	uint64_t items_received = 0;
+};
+
+// Public chat history reconciled between peers with range-based set
+// reconciliation.
+//
+// Items are ordered by id. A "sync" frame carries ranges of the id space, each
+// either as a fingerprint (count + sum of mixed ids) or, for small ranges, the
+// full id list. The receiver compares every fingerprint range with its own
+// items: equal ranges are done, small ones are answered with an id list, and
+// large ones are split into BUCKETS sub-ranges whose fingerprints go back. An
+// id list settles its range outright: the receiver sends the items missing on
+// the other side and asks for the ones it lacks. Peers that agree exchange one
+// frame; otherwise the cost grows with the difference (times log of the
+// history size), not with the history. A sync frame with ranges is always
+// answered with one, empty once nothing is left to compare, so the side that
+// opened learns the exchange settled.
+//
+// Frames are not retransmitted: the opener re-runs begin() until a round
+// settles without exchanging anything, which refetches whatever a lost frame
+// carried.
+//
+// Pure bookkeeping: the caller sends the frames it is handed.
+class HistorySync
+{
+public:
+	static constexpr size_t BUCKETS = 16;
+	static constexpr size_t ID_LIST_THRESHOLD = 16; // Ranges this small are sent as id lists
+	static constexpr size_t MAX_FRAME_BYTES = 32 * 1024; // Every frame is split to stay under this (one oversized item goes alone)
+
+	static uint64_t makeId(const std::string &from, int64_t ts_us, const std::string &body);
+
+	// Timestamps for history items. Steady clocks count from an arbitrary
+	// point on each machine, so only wall time orders items across peers.
+	static int64_t wallMicros();
+
+	bool add(HistoryItem item); // False if already known
+	bool contains(uint64_t id) const { return items.count(id) > 0; }
+	size_t size() const { return items.size(); }
+
+	// Opening frame: one fingerprint over the whole id space
+	std::string begin();
+
+	// Handles a "sync", "want" or "history" frame and returns the frames to send back.
+	// Items learned from a "history" frame are appended to 'learned'. Fields of
+	// the wrong type are skipped (the item, id or range they belong to).
+	// 'settled' is set when the frame was the empty sync that ends an exchange.
+	std::vector<std::string> onFrame(const nlohmann::json &frame, size_t wire_bytes, std::vector<HistoryItem> &learned, bool &settled);
+
+	HistorySyncStats stats() const;
+
+private:
+	struct Fingerprint
+	{
+		uint64_t sum = 0;
+		uint64_t count = 0;
+		bool operator==(const Fingerprint &other) const = default;
+	};
+
+	using Map = std::map<uint64_t, HistoryItem>;
+
+	Fingerprint fingerprint(Map::const_iterator first, Map::const_iterator last) const;
+	std::vector<std::string> historyFrames(const std::vector<const HistoryItem *> &send);
+	std::vector<std::string> splitFrames(const char *type, const char *key, nlohmann::json entries); // Packs entries under MAX_FRAME_BYTES
+	std::string track(std::string frame); // Counts sent bytes
+
+	Map items;
+	size_t history_bytes = 0;
+	HistorySyncStats counters;
+};
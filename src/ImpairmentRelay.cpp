@@ -0,0 +1,377 @@
+#include "ImpairmentRelay.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+std::optional<ImpairmentConfig> ImpairmentConfig::parse(const std::string &spec)
+{
+	ImpairmentConfig config;
+	std::stringstream stream(spec);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		size_t eq = item.find('=');
+		if (eq == std::string::npos)
+		{
+			return std::nullopt;
+		}
+
+		std::string key = item.substr(0, eq);
+		std::string value = item.substr(eq + 1);
+		try
+		{
+			if (key == "loss")
+				config.loss = std::stod(value);
+			else if (key == "delay")
+				config.delay_ms = std::stod(value);
+			else if (key == "jitter")
+				config.jitter_ms = std::stod(value);
+			else if (key == "reorder")
+				config.reorder = std::stod(value);
+			else if (key == "reorder_gap")
+				config.reorder_gap_ms = std::stod(value);
+			else if (key == "rate")
+				config.rate_kbps = std::stod(value);
+			else if (key == "queue")
+				config.queue_bytes = std::stoul(value);
+			else if (key == "seed")
+				config.seed = static_cast<uint32_t>(std::stoul(value));
+			else
+				return std::nullopt;
+		}
+		catch (const std::exception &)
+		{
+			return std::nullopt;
+		}
+	}
+	return config;
+}
+
+std::string ImpairmentConfig::describe() const
+{
+	std::stringstream out;
+	out << "loss " << loss * 100.0 << "%, delay " << delay_ms << " ms +/- " << jitter_ms << " ms, reorder "
+		<< reorder * 100.0 << "%, rate " << (rate_kbps > 0 ? std::to_string(static_cast<int>(rate_kbps)) + " kbit/s" : "unlimited")
+		<< ", seed " << seed;
+	return out.str();
+}
+
+ImpairmentRelay::ImpairmentRelay(const ImpairmentConfig &config) : settings(config), rng(config.seed)
+{
+}
+
+ImpairmentRelay::~ImpairmentRelay()
+{
+	stop();
+	for (auto &forward : forwards)
+	{
+		net::closeSocket(forward->sock);
+	}
+}
+
+bool ImpairmentRelay::start()
+{
+	if (!net::init())
+	{
+		std::cout << "Impairment relay: socket init failed" << std::endl;
+		return false;
+	}
+	running = true;
+	thread = std::thread(&ImpairmentRelay::run, this);
+	std::cout << "Impairment relay running: " << settings.describe() << std::endl;
+	return true;
+}
+
+void ImpairmentRelay::stop()
+{
+	running = false;
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+uint16_t ImpairmentRelay::addForward(const std::string &target_ip, uint16_t target_port)
+{
+	sockaddr_in target{};
+	target.sin_family = AF_INET;
+	target.sin_port = htons(target_port);
+	if (inet_pton(AF_INET, target_ip.c_str(), &target.sin_addr) != 1)
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// One relay port per remote address, however often it is announced
+	for (const auto &forward : forwards)
+	{
+		if (forward->target.sin_addr.s_addr == target.sin_addr.s_addr && forward->target.sin_port == target.sin_port)
+		{
+			sockaddr_in local{};
+			socklen_t len = sizeof(local);
+			getsockname(forward->sock, reinterpret_cast<sockaddr *>(&local), &len);
+			return ntohs(local.sin_port);
+		}
+	}
+
+	socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET_HANDLE)
+	{
+		return 0;
+	}
+
+	sockaddr_in local{};
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = 0;
+	socklen_t len = sizeof(local);
+	if (bind(sock, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0 ||
+		getsockname(sock, reinterpret_cast<sockaddr *>(&local), &len) != 0 || !net::setNonBlocking(sock))
+	{
+		net::closeSocket(sock);
+		return 0;
+	}
+
+	auto forward = std::make_unique<Forward>();
+	forward->sock = sock;
+	forward->target = target;
+	forwards.push_back(std::move(forward));
+
+	uint16_t port = ntohs(local.sin_port);
+	std::cout << "Impairment relay: port " << port << " -> " << target_ip << ":" << target_port << std::endl;
+	return port;
+}
+
+std::optional<std::string> ImpairmentRelay::rewriteCandidate(const std::string &candidate)
+{
+	// a=candidate:<foundation> <component> <transport> <priority> <address> <port> typ <type> ...
+	std::string prefix = candidate.rfind("a=", 0) == 0 ? "a=" : "";
+	std::stringstream stream(candidate.substr(prefix.size()));
+	std::vector<std::string> fields;
+	std::string field;
+	while (stream >> field)
+	{
+		fields.push_back(field);
+	}
+
+	if (fields.size() < 8)
+	{
+		return std::nullopt;
+	}
+
+	std::string transport = fields[2];
+	std::transform(transport.begin(), transport.end(), transport.begin(), [](unsigned char c)
+				   { return static_cast<char>(std::toupper(c)); });
+	if (transport != "UDP" || fields[4].find(':') != std::string::npos)
+	{
+		return std::nullopt;
+	}
+
+	// A port the peer sent us: anything but a plain 1-65535 drops the candidate
+	unsigned long port = 0;
+	const std::string &port_field = fields[5];
+	auto [end, error] = std::from_chars(port_field.data(), port_field.data() + port_field.size(), port);
+	if (error != std::errc() || end != port_field.data() + port_field.size() || port == 0 || port > 65535)
+	{
+		return std::nullopt;
+	}
+
+	uint16_t relay_port = addForward(fields[4], static_cast<uint16_t>(port));
+	if (relay_port == 0)
+	{
+		return std::nullopt;
+	}
+	fields[5] = std::to_string(relay_port);
+
+	std::string rewritten = prefix;
+	for (size_t i = 0; i < fields.size(); i++)
+	{
+		rewritten += (i > 0 ? " " : "") + fields[i];
+	}
+	return rewritten;
+}
+
+std::string ImpairmentRelay::rewriteSdp(const std::string &sdp)
+{
+	std::string result;
+	size_t start = 0;
+	while (start < sdp.size())
+	{
+		size_t end = sdp.find('\n', start);
+		std::string line = sdp.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		start = end == std::string::npos ? sdp.size() : end + 1;
+
+		bool has_cr = !line.empty() && line.back() == '\r';
+		if (has_cr)
+		{
+			line.pop_back();
+		}
+
+		if (line.rfind("a=candidate:", 0) == 0)
+		{
+			auto rewritten = rewriteCandidate(line);
+			if (!rewritten)
+			{
+				continue;
+			}
+			line = *rewritten;
+		}
+		result += line + (has_cr ? "\r\n" : "\n");
+	}
+	return result;
+}
+
+ImpairmentRelay::Stats ImpairmentRelay::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return counters;
+}
+
+void ImpairmentRelay::impair(Forward &forward, Link &link, const sockaddr_in &dest, const char *data, size_t size)
+{
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	Clock::time_point now = Clock::now();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	counters.received++;
+
+	if (chance(rng) < settings.loss)
+	{
+		counters.dropped_loss++;
+		return;
+	}
+
+	double delay_ms = settings.delay_ms;
+	if (settings.jitter_ms > 0.0)
+	{
+		delay_ms += std::uniform_real_distribution<double>(-settings.jitter_ms, settings.jitter_ms)(rng);
+	}
+	if (chance(rng) < settings.reorder)
+	{
+		delay_ms += settings.reorder_gap_ms;
+		counters.reordered++;
+	}
+	auto delay = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(std::max(delay_ms, 0.0)));
+
+	// Bandwidth cap: serialize behind earlier datagrams, drop when the queue is full
+	Clock::time_point departs = now;
+	if (settings.rate_kbps > 0.0)
+	{
+		if (link.queued_bytes + size > settings.queue_bytes)
+		{
+			counters.dropped_queue++;
+			return;
+		}
+		auto transmit = std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(static_cast<double>(size) * 8.0 / (settings.rate_kbps * 1000.0)));
+		departs = std::max(now, link.free_at) + transmit;
+		link.free_at = departs;
+		link.queued_bytes += size;
+	}
+
+	scheduled.push({departs + delay, next_order++, &forward, &link, dest, std::vector<char>(data, data + size)});
+}
+
+void ImpairmentRelay::sendDue(Clock::time_point now)
+{
+	while (!scheduled.empty() && scheduled.top().due <= now)
+	{
+		const Scheduled &packet = scheduled.top();
+		sendto(packet.forward->sock, packet.data.data(), static_cast<int>(packet.data.size()), 0,
+			   reinterpret_cast<const sockaddr *>(&packet.dest), sizeof(packet.dest));
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (settings.rate_kbps > 0.0)
+			{
+				packet.link->queued_bytes -= std::min(packet.link->queued_bytes, packet.data.size());
+			}
+			counters.forwarded++;
+			counters.bytes_forwarded += packet.data.size();
+		}
+		scheduled.pop();
+	}
+}
+
+void ImpairmentRelay::run()
+{
+	std::vector<pollfd_t> fds;
+	std::vector<Forward *> polled;
+	char buffer[65536];
+
+	while (running)
+	{
+		fds.clear();
+		polled.clear();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto &forward : forwards)
+			{
+				pollfd_t fd{};
+				fd.fd = forward->sock;
+				fd.events = POLLIN;
+				fds.push_back(fd);
+				polled.push_back(forward.get());
+			}
+		}
+
+		// Sleep until the next datagram is due, but re-check for new forwards regularly
+		int timeout_ms = 5;
+		if (!scheduled.empty())
+		{
+			auto until_due = std::chrono::duration_cast<std::chrono::milliseconds>(scheduled.top().due - Clock::now()).count();
+			timeout_ms = static_cast<int>(std::clamp<long long>(until_due, 0, timeout_ms));
+		}
+
+		if (fds.empty())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+		}
+		else if (net::poll(fds.data(), fds.size(), timeout_ms) > 0)
+		{
+			for (size_t i = 0; i < fds.size(); i++)
+			{
+				if (!(fds[i].revents & POLLIN))
+				{
+					continue;
+				}
+
+				Forward &forward = *polled[i];
+				while (true)
+				{
+					sockaddr_in from{};
+					socklen_t from_len = sizeof(from);
+					int received = static_cast<int>(recvfrom(forward.sock, buffer, sizeof(buffer), 0,
+															 reinterpret_cast<sockaddr *>(&from), &from_len));
+					if (received <= 0)
+					{
+						break;
+					}
+
+					bool from_target = from.sin_addr.s_addr == forward.target.sin_addr.s_addr && from.sin_port == forward.target.sin_port;
+					if (from_target)
+					{
+						if (forward.has_client)
+						{
+							impair(forward, forward.to_client, forward.client, buffer, static_cast<size_t>(received));
+						}
+					}
+					else
+					{
+						// Anything not from the peer is our own ICE agent
+						forward.client = from;
+						forward.has_client = true;
+						impair(forward, forward.to_target, forward.target, buffer, static_cast<size_t>(received));
+					}
+				}
+			}
+		}
+
+		sendDue(Clock::now());
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Net.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Network conditions applied by the relay, to each direction independently
+struct ImpairmentConfig
+{
+	double loss = 0.0;			  // Probability a datagram is dropped
+	double delay_ms = 0.0;		  // Fixed one-way delay
+	double jitter_ms = 0.0;		  // Uniform +/- variation on top of the delay
+	double reorder = 0.0;		  // Probability a datagram is held back by reorder_gap_ms
+	double reorder_gap_ms = 5.0;
+	double rate_kbps = 0.0;		  // Bandwidth cap, 0 = unlimited
+	size_t queue_bytes = 256 * 1024; // Drop-tail queue in front of the bandwidth cap
+	uint32_t seed = 1;			  // Same seed + same traffic = same drops
+
+	// "loss=0.05,delay=40,jitter=10,reorder=0.01,rate=2000,queue=65536,seed=7"
+	static std::optional<ImpairmentConfig> parse(const std::string &spec);
+	std::string describe() const;
+};
+
+// Local UDP relay that sits between this client's ICE agent and a peer.
+//
+// Every remote ICE candidate is rewritten to point at a relay port that
+// forwards to the real candidate address, so all peer traffic crosses the
+// relay and gets the configured loss, delay, jitter, reordering and rate cap.
+// Meant for benchmarking on a single host: the rewritten candidate keeps the
+// peer's address and only swaps the port, which works because that address is
+// local. Run both peers with the relay so neither learns a direct path.
+class ImpairmentRelay
+{
+public:
+	struct Stats
+	{
+		uint64_t received = 0;
+		uint64_t forwarded = 0;
+		uint64_t dropped_loss = 0;
+		uint64_t dropped_queue = 0;
+		uint64_t reordered = 0;
+		uint64_t bytes_forwarded = 0;
+	};
+
+	explicit ImpairmentRelay(const ImpairmentConfig &config);
+	~ImpairmentRelay();
+
+	ImpairmentRelay(const ImpairmentRelay &) = delete;
+	ImpairmentRelay &operator=(const ImpairmentRelay &) = delete;
+
+	bool start();
+	void stop();
+
+	// Opens a relay port forwarding to target; returns the port, 0 on failure
+	uint16_t addForward(const std::string &target_ip, uint16_t target_port);
+
+	// Rewrites an "a=candidate:" line to go through a relay port. Returns
+	// std::nullopt for candidates that would bypass the relay (TCP, IPv6).
+	std::optional<std::string> rewriteCandidate(const std::string &candidate);
+
+	// Applies rewriteCandidate to every candidate line of an SDP
+	std::string rewriteSdp(const std::string &sdp);
+
+	const ImpairmentConfig &config() const { return settings; }
+	Stats stats() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// One direction of a forward: its own bandwidth/queue state
+	struct Link
+	{
+		Clock::time_point free_at;
+		size_t queued_bytes = 0;
+	};
+
+	struct Forward
+	{
+		socket_t sock = INVALID_SOCKET_HANDLE;
+		sockaddr_in target{};
+		sockaddr_in client{};
+		bool has_client = false;
+		Link to_target;
+		Link to_client;
+	};
+
+	struct Scheduled
+	{
+		Clock::time_point due;
+		uint64_t order;
+		Forward *forward;
+		Link *link;
+		sockaddr_in dest;
+		std::vector<char> data;
+
+		bool operator>(const Scheduled &other) const
+		{
+			return due != other.due ? due > other.due : order > other.order;
+		}
+	};
+
+	void run();
+	void impair(Forward &forward, Link &link, const sockaddr_in &dest, const char *data, size_t size);
+	void sendDue(Clock::time_point now);
+
+	ImpairmentConfig settings;
+	std::mt19937 rng;
+
+	mutable std::mutex mutex; // Guards forwards and counters
+	std::vector<std::unique_ptr<Forward>> forwards;
+	Stats counters;
+
+	std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<>> scheduled; // Relay thread only
+	uint64_t next_order = 0;
+
+	std::atomic<bool> running{false};
+	std::thread thread;
+};
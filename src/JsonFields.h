@@ -0,0 +1,37 @@
+#pragma once
+
+// Type checks for fields of JSON that came from a peer. nlohmann's const
+// operator[] on a missing key is undefined behaviour, not an exception, so
+// every field a peer sends is checked with one of these before it is read.
+
+#include <nlohmann/json.hpp>
+
+inline bool isUnsigned(const nlohmann::json &object, const char *key)
+{
+	auto it = object.find(key);
+	return it != object.end() && it->is_number_unsigned();
+}
+
+inline bool isInteger(const nlohmann::json &object, const char *key)
+{
+	auto it = object.find(key);
+	return it != object.end() && it->is_number_integer();
+}
+
+inline bool isString(const nlohmann::json &object, const char *key)
+{
+	auto it = object.find(key);
+	return it != object.end() && it->is_string();
+}
+
+inline bool isArray(const nlohmann::json &object, const char *key)
+{
+	auto it = object.find(key);
+	return it != object.end() && it->is_array();
+}
+
+inline bool isObject(const nlohmann::json &object, const char *key)
+{
+	auto it = object.find(key);
+	return it != object.end() && it->is_object();
+}
@@ -0,0 +1,432 @@
+#include "LanDiscovery.h"
+#include "JsonFields.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using json = nlohmann::json;
+
+LanDiscovery::LanDiscovery(std::string id, uint16_t port) : client_id(std::move(id)), group_port(port)
+{
+	std::random_device random;
+	epoch = (static_cast<uint64_t>(random()) << 32) | random();
+}
+
+LanDiscovery::~LanDiscovery()
+{
+	stop();
+}
+
+bool LanDiscovery::start()
+{
+	if (!net::init())
+	{
+		std::cout << "LAN discovery: socket init failed" << std::endl;
+		return false;
+	}
+
+	group_address.sin_family = AF_INET;
+	group_address.sin_port = htons(group_port);
+	inet_pton(AF_INET, GROUP, &group_address.sin_addr);
+
+	// Group socket: every client on the host binds the same port
+	group_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (group_sock == INVALID_SOCKET_HANDLE)
+	{
+		std::cout << "LAN discovery: cannot create socket" << std::endl;
+		return false;
+	}
+	int on = 1;
+	setsockopt(group_sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&on), sizeof(on));
+#ifdef SO_REUSEPORT
+	setsockopt(group_sock, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char *>(&on), sizeof(on));
+#endif
+
+	sockaddr_in any{};
+	any.sin_family = AF_INET;
+	any.sin_addr.s_addr = htonl(INADDR_ANY);
+	any.sin_port = htons(group_port);
+
+	ip_mreq membership{};
+	membership.imr_multiaddr = group_address.sin_addr;
+	membership.imr_interface.s_addr = htonl(INADDR_ANY);
+
+	if (bind(group_sock, reinterpret_cast<sockaddr *>(&any), sizeof(any)) != 0 ||
+		setsockopt(group_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char *>(&membership), sizeof(membership)) != 0)
+	{
+		std::cout << "LAN discovery: cannot join " << GROUP << ":" << group_port << std::endl;
+		net::closeSocket(group_sock);
+		group_sock = INVALID_SOCKET_HANDLE;
+		return false;
+	}
+
+	// Unicast socket for signaling, on whatever port the OS hands out
+	unicast_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	sockaddr_in local{};
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	socklen_t len = sizeof(local);
+	if (unicast_sock == INVALID_SOCKET_HANDLE || bind(unicast_sock, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0 ||
+		getsockname(unicast_sock, reinterpret_cast<sockaddr *>(&local), &len) != 0)
+	{
+		std::cout << "LAN discovery: cannot bind signaling socket" << std::endl;
+		stop();
+		return false;
+	}
+	unicast_port = ntohs(local.sin_port);
+
+	// Beacons go out through the unicast socket, so it carries the multicast settings
+	unsigned char ttl = 1;	// Stay on the local subnet
+	unsigned char loop = 1; // Other clients on this host must hear us
+	setsockopt(unicast_sock, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char *>(&ttl), sizeof(ttl));
+	setsockopt(unicast_sock, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast<const char *>(&loop), sizeof(loop));
+
+	net::setNonBlocking(group_sock);
+	net::setNonBlocking(unicast_sock);
+
+	running = true;
+	thread = std::thread(&LanDiscovery::run, this);
+	std::cout << "LAN discovery on " << GROUP << ":" << group_port << ", signaling on port " << unicast_port << std::endl;
+	return true;
+}
+
+void LanDiscovery::stop()
+{
+	if (running.exchange(false))
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+		sendBeacon("bye");
+	}
+	if (group_sock != INVALID_SOCKET_HANDLE)
+	{
+		net::closeSocket(group_sock);
+		group_sock = INVALID_SOCKET_HANDLE;
+	}
+	if (unicast_sock != INVALID_SOCKET_HANDLE)
+	{
+		net::closeSocket(unicast_sock);
+		unicast_sock = INVALID_SOCKET_HANDLE;
+	}
+}
+
+bool LanDiscovery::send(const std::string &peer_id, const std::string &message)
+{
+	sockaddr_in target;
+	uint64_t seq;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = peer_table.find(peer_id);
+		if (it == peer_table.end())
+		{
+			return false;
+		}
+		target = it->second.address;
+		seq = next_seq++;
+	}
+
+	json envelope = {
+		{"type", "message"},
+		{"from", client_id},
+		{"epoch", epoch},
+		{"seq", seq},
+		{"body", message}
+	};
+	std::string wire = envelope.dump();
+	if (wire.size() > MAX_MESSAGE)
+	{
+		return false;
+	}
+	bool sent = sendTo(target, wire);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	(sent ? counters.messages_sent : counters.send_failures)++;
+	if (sent)
+	{
+		pending[seq] = {peer_id, std::move(wire), Clock::now() + RETRY_INTERVAL};
+	}
+	return sent;
+}
+
+bool LanDiscovery::sendTo(const sockaddr_in &target, const std::string &wire)
+{
+	return sendto(unicast_sock, wire.data(), static_cast<int>(wire.size()), 0,
+				  reinterpret_cast<const sockaddr *>(&target), sizeof(target)) == static_cast<int>(wire.size());
+}
+
+void LanDiscovery::retransmit(Clock::time_point now)
+{
+	std::vector<std::pair<sockaddr_in, std::string>> due;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto it = pending.begin(); it != pending.end();)
+		{
+			Pending &message = it->second;
+			if (now < message.next_try)
+			{
+				++it;
+				continue;
+			}
+
+			// The target left, or never answered
+			auto peer = peer_table.find(message.peer_id);
+			if (peer == peer_table.end() || message.attempts >= MAX_ATTEMPTS)
+			{
+				counters.unacked++;
+				it = pending.erase(it);
+				continue;
+			}
+
+			// To the address the latest beacon gave
+			message.next_try = now + RETRY_INTERVAL * (1 << message.attempts);
+			message.attempts++;
+			counters.retransmits++;
+			due.emplace_back(peer->second.address, message.wire);
+			++it;
+		}
+	}
+
+	for (const auto &[target, wire] : due)
+	{
+		sendTo(target, wire);
+	}
+}
+
+std::vector<std::string> LanDiscovery::peers() const
+{
+	std::vector<std::string> ids;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ids.reserve(peer_table.size());
+		for (const auto &[id, peer] : peer_table)
+		{
+			ids.push_back(id);
+		}
+	}
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+bool LanDiscovery::knows(const std::string &peer_id) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return peer_table.find(peer_id) != peer_table.end();
+}
+
+LanDiscoveryStats LanDiscovery::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	LanDiscoveryStats result = counters;
+	result.peers = peer_table.size();
+	return result;
+}
+
+void LanDiscovery::sendBeacon(const char *type)
+{
+	json beacon = {
+		{"type", type},
+		{"from", client_id},
+		{"port", unicast_port}
+	};
+	std::string wire = beacon.dump();
+	// The unicast socket sends, so the group socket only ever receives
+	if (sendto(unicast_sock, wire.data(), static_cast<int>(wire.size()), 0,
+			   reinterpret_cast<const sockaddr *>(&group_address), sizeof(group_address)) == static_cast<int>(wire.size()))
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		counters.beacons_sent++;
+	}
+}
+
+void LanDiscovery::receiveBeacons()
+{
+	char buffer[2048];
+	for (;;)
+	{
+		sockaddr_in from{};
+		socklen_t from_len = sizeof(from);
+		int received = static_cast<int>(recvfrom(group_sock, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from), &from_len));
+		if (received <= 0)
+		{
+			break;
+		}
+
+		json beacon = json::parse(buffer, buffer + received, nullptr, false);
+		if (beacon.is_discarded() || !beacon.is_object() || !beacon.contains("from") || !beacon["from"].is_string())
+		{
+			continue;
+		}
+
+		// Anyone on the LAN can send to the group: check every field's type before reading it
+		std::string id = beacon["from"];
+		auto type_field = beacon.find("type");
+		std::string type = type_field != beacon.end() && type_field->is_string() ? type_field->get<std::string>() : "";
+		if (id.empty() || id == client_id)
+		{
+			continue;
+		}
+
+		uint16_t port = 0;
+		if (type == "beacon")
+		{
+			auto port_field = beacon.find("port");
+			if (port_field == beacon.end() || !port_field->is_number_unsigned() || port_field->get<uint64_t>() == 0 ||
+				port_field->get<uint64_t>() > 65535)
+			{
+				continue;
+			}
+			port = static_cast<uint16_t>(port_field->get<uint64_t>());
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		counters.beacons_received++;
+		if (type == "bye")
+		{
+			peer_table.erase(id);
+		}
+		else if (type == "beacon")
+		{
+			// Reply to the source address of the beacon, at the port it announced.
+			// The only place a known peer's address changes.
+			auto &peer = peer_table[id];
+			peer.address = from;
+			peer.address.sin_port = htons(port);
+			peer.last_seen = Clock::now();
+		}
+	}
+}
+
+void LanDiscovery::receiveMessages()
+{
+	for (;;)
+	{
+		sockaddr_in from{};
+		socklen_t from_len = sizeof(from);
+		int received = static_cast<int>(recvfrom(unicast_sock, receive_buffer.data(), static_cast<int>(receive_buffer.size()), 0,
+												 reinterpret_cast<sockaddr *>(&from), &from_len));
+		if (received <= 0)
+		{
+			break;
+		}
+
+		json envelope = json::parse(receive_buffer.data(), receive_buffer.data() + received, nullptr, false);
+		if (envelope.is_discarded() || !envelope.is_object() || !isString(envelope, "type") || !isString(envelope, "from") ||
+			!isUnsigned(envelope, "seq"))
+		{
+			continue;
+		}
+		std::string type = envelope["type"];
+		std::string id = envelope["from"];
+		uint64_t seq = envelope["seq"].get<uint64_t>();
+		if (id.empty() || id == client_id)
+		{
+			continue;
+		}
+
+		if (type == "ack")
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = pending.find(seq);
+			if (it != pending.end() && it->second.peer_id == id)
+			{
+				pending.erase(it);
+			}
+			continue;
+		}
+		if (type != "message" || !isUnsigned(envelope, "epoch") || !isString(envelope, "body"))
+		{
+			continue;
+		}
+
+		// Ack duplicates too: the retransmit means our first ack was lost
+		json ack = {
+			{"type", "ack"},
+			{"from", client_id},
+			{"seq", seq}
+		};
+		sendTo(from, ack.dump());
+
+		bool duplicate;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// A sender whose beacon we have not heard yet: learn it from the message so the answer can go back.
+			// A known id keeps the address its beacon gave; a message cannot move it.
+			auto [entry, added] = peer_table.try_emplace(id);
+			Peer &peer = entry->second;
+			if (added)
+			{
+				peer.address = from;
+				peer.last_seen = Clock::now();
+			}
+
+			uint64_t sender_epoch = envelope["epoch"].get<uint64_t>();
+			if (peer.epoch != sender_epoch)
+			{
+				peer.epoch = sender_epoch;
+				peer.seen.clear();
+			}
+			duplicate = std::find(peer.seen.begin(), peer.seen.end(), seq) != peer.seen.end();
+			if (!duplicate)
+			{
+				counters.messages_received++;
+				peer.seen.push_back(seq);
+				if (peer.seen.size() > SEEN_WINDOW)
+				{
+					peer.seen.erase(peer.seen.begin());
+				}
+			}
+		}
+
+		if (!duplicate && onMessage)
+		{
+			onMessage(envelope["body"].get<std::string>());
+		}
+	}
+}
+
+void LanDiscovery::run()
+{
+	Clock::time_point next_beacon = Clock::now();
+	while (running)
+	{
+		Clock::time_point now = Clock::now();
+		if (now >= next_beacon)
+		{
+			sendBeacon("beacon");
+			next_beacon = now + BEACON_INTERVAL;
+
+			// Peers that went quiet without saying goodbye
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto it = peer_table.begin(); it != peer_table.end();)
+			{
+				it = now - it->second.last_seen > PEER_TIMEOUT ? peer_table.erase(it) : std::next(it);
+			}
+		}
+
+		retransmit(now);
+
+		pollfd_t fds[2] = {};
+		fds[0].fd = group_sock;
+		fds[0].events = POLLIN;
+		fds[1].fd = unicast_sock;
+		fds[1].events = POLLIN;
+		if (net::poll(fds, 2, 100) <= 0)
+		{
+			continue;
+		}
+		if (fds[0].revents & POLLIN)
+		{
+			receiveBeacons();
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			receiveMessages();
+		}
+	}
+}
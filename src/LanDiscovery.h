@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Net.h"
+
+struct LanDiscoveryStats
+{
+	size_t peers = 0;
+	uint64_t beacons_sent = 0;
+	uint64_t beacons_received = 0;
+	uint64_t messages_sent = 0;
+	uint64_t messages_received = 0;
+	uint64_t send_failures = 0;
+	uint64_t retransmits = 0;
+	uint64_t unacked = 0; // Messages given up on after MAX_ATTEMPTS
+};
+
+// Serverless signaling on the local network.
+//
+// Every client multicasts a small beacon once a second on 239.255.42.99 naming
+// its id and the port of its own unicast socket; the peer list is whoever
+// beaconed recently. Signaling messages (requests, offers, answers, candidates)
+// go as single datagrams straight to the target's unicast socket, numbered and
+// resent until the target acks them. Only a beacon sets or moves a known
+// peer's address; a message from an unknown id adds it so the answer can go
+// back, but cannot take over an id that is already known. The group
+// port is shared (SO_REUSEADDR/SO_REUSEPORT) and multicast loopback is on, so
+// several clients can run on one host.
+class LanDiscovery
+{
+public:
+	static constexpr const char *GROUP = "239.255.42.99";
+	static constexpr uint16_t DEFAULT_PORT = 42099;
+	static constexpr size_t MAX_MESSAGE = 65507; // Largest UDP payload; SDP offers are a few KB
+
+	LanDiscovery(std::string client_id, uint16_t group_port = DEFAULT_PORT);
+	~LanDiscovery();
+
+	LanDiscovery(const LanDiscovery &) = delete;
+	LanDiscovery &operator=(const LanDiscovery &) = delete;
+
+	bool start();
+	void stop(); // Says goodbye so peers drop us at once
+
+	// Sends one signaling message to a discovered peer and keeps resending it until acked;
+	// false if the peer is unknown or the first send failed
+	bool send(const std::string &peer_id, const std::string &message);
+
+	std::vector<std::string> peers() const; // Sorted, excluding ourselves
+	bool knows(const std::string &peer_id) const;
+	LanDiscoveryStats stats() const;
+
+	// Called on the discovery thread for every signaling message addressed to us
+	std::function<void(std::string message)> onMessage;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Peer
+	{
+		sockaddr_in address{}; // Unicast socket
+		Clock::time_point last_seen;
+		uint64_t epoch = 0;		// Sender instance whose sequence numbers 'seen' holds
+		std::vector<uint64_t> seen; // Recent sequence numbers, to drop retransmitted duplicates
+	};
+
+	// A message waiting for its ack
+	struct Pending
+	{
+		std::string peer_id;
+		std::string wire;
+		Clock::time_point next_try;
+		int attempts = 1;
+	};
+
+	void run();
+	void sendBeacon(const char *type);
+	void receiveBeacons();
+	void receiveMessages();
+	void retransmit(Clock::time_point now);
+	bool sendTo(const sockaddr_in &target, const std::string &wire);
+
+	std::string client_id;
+	uint16_t group_port;
+	socket_t group_sock = INVALID_SOCKET_HANDLE;
+	socket_t unicast_sock = INVALID_SOCKET_HANDLE;
+	uint16_t unicast_port = 0;
+	sockaddr_in group_address{};
+	std::vector<char> receive_buffer = std::vector<char>(MAX_MESSAGE); // Discovery thread only
+
+	mutable std::mutex mutex; // Guards peers and counters
+	std::unordered_map<std::string, Peer> peer_table;
+	LanDiscoveryStats counters;
+	uint64_t epoch;		  // Random per instance, so a restarted peer's numbering is not taken for duplicates
+	uint64_t next_seq = 1;
+	std::unordered_map<uint64_t, Pending> pending; // seq -> message
+
+	std::atomic<bool> running{false};
+	std::thread thread;
+
+	static constexpr std::chrono::seconds BEACON_INTERVAL{1};
+	static constexpr std::chrono::seconds PEER_TIMEOUT{5};
+	static constexpr std::chrono::milliseconds RETRY_INTERVAL{300}; // Doubles after each try
+	static constexpr int MAX_ATTEMPTS = 5;
+	static constexpr size_t SEEN_WINDOW = 256;
+};
@@ -0,0 +1,79 @@
+#include "LatencyProbe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void LatencyHistogram::add(double latency_ms)
+{
+	double us = std::max(latency_ms * 1000.0, 50.0);
+	int bucket = static_cast<int>(2.0 * std::log2(us / 50.0));
+	counts[std::clamp(bucket, 0, BUCKETS - 1)]++;
+	total++;
+}
+
+double LatencyHistogram::bucketUpperMs(int bucket)
+{
+	return 0.05 * std::exp2((bucket + 1) / 2.0);
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+	if (total == 0)
+	{
+		return -1.0;
+	}
+
+	uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(total)));
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= std::max<uint64_t>(rank, 1))
+		{
+			return bucketUpperMs(i);
+		}
+	}
+	return bucketUpperMs(BUCKETS - 1);
+}
+
+double LatencyEstimator::addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3)
+{
+	Sample sample;
+	sample.rtt_us = std::max<int64_t>((t3 - t0) - (t2 - t1), 0);
+	sample.offset_us = ((t1 - t0) + (t2 - t3)) / 2;
+
+	samples.push_back(sample);
+	if (samples.size() > FILTER_SAMPLES)
+	{
+		samples.pop_front();
+	}
+	return sample.rtt_us / 1000.0;
+}
+
+const LatencyEstimator::Sample &LatencyEstimator::best() const
+{
+	return *std::min_element(samples.begin(), samples.end(), [](const Sample &a, const Sample &b)
+							 { return a.rtt_us < b.rtt_us; });
+}
+
+double LatencyEstimator::rttMs() const
+{
+	return hasEstimate() ? best().rtt_us / 1000.0 : -1.0;
+}
+
+int64_t LatencyEstimator::offsetMicros() const
+{
+	return hasEstimate() ? best().offset_us : 0;
+}
+
+double LatencyEstimator::oneWayMs(int64_t peer_timestamp_us, int64_t local_now_us) const
+{
+	int64_t sent_local_us = peer_timestamp_us - offsetMicros();
+	return std::max<int64_t>(local_now_us - sent_local_us, 0) / 1000.0;
+}
+
+int64_t LatencyEstimator::nowMicros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
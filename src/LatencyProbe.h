@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Log-scale latency histogram: bucket i covers [50us * 2^(i/2), 50us * 2^((i+1)/2)),
+// i.e. 50 us up to ~50 s in half-octave steps
+class LatencyHistogram
+{
+public:
+	static constexpr int BUCKETS = 40;
+
+	void add(double latency_ms);
+	double percentile(double p) const; // ms (bucket upper bound), -1 when empty
+	uint64_t count() const { return total; }
+	const std::array<uint64_t, BUCKETS> &buckets() const { return counts; }
+
+	static double bucketUpperMs(int bucket);
+
+private:
+	std::array<uint64_t, BUCKETS> counts{};
+	uint64_t total = 0;
+};
+
+// NTP-style RTT and clock-offset estimation from ping/pong timestamps:
+//   t0 = ping sent (local), t1 = ping received (peer), t2 = pong sent (peer), t3 = pong received (local)
+// Of the recent samples the one with the smallest RTT is trusted most, since
+// it saw the least queueing (the NTP clock filter).
+class LatencyEstimator
+{
+public:
+	// Returns the sample's round-trip time in ms
+	double addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3);
+
+	bool hasEstimate() const { return !samples.empty(); }
+	double rttMs() const;		// Filtered round-trip time
+	int64_t offsetMicros() const; // Peer clock minus local clock
+
+	// Converts a peer timestamp to local time and returns how long ago it was
+	double oneWayMs(int64_t peer_timestamp_us, int64_t local_now_us) const;
+
+	// Monotonic microsecond clock used for all probe timestamps
+	static int64_t nowMicros();
+
+	static constexpr size_t FILTER_SAMPLES = 8;
+
+private:
+	struct Sample
+	{
+		int64_t rtt_us;
+		int64_t offset_us;
+	};
+
+	const Sample &best() const;
+
+	std::deque<Sample> samples;
+};
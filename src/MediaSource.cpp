@@ -0,0 +1,283 @@
+#include "MediaSource.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static bool readFile(const std::string &path, std::vector<std::byte> &out)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+	out.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	return static_cast<bool>(file.read(reinterpret_cast<char *>(out.data()), static_cast<std::streamsize>(out.size())));
+}
+
+static std::string extensionOf(const std::string &path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return "";
+	}
+	std::string ext = path.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c)
+				   { return static_cast<char>(std::tolower(c)); });
+	return ext;
+}
+
+std::shared_ptr<const MediaSource> MediaSource::load(const std::string &path, double video_fps)
+{
+	std::string ext = extensionOf(path);
+	if (ext == "h264" || ext == "264")
+	{
+		return loadH264(path, video_fps);
+	}
+	if (ext == "ogg" || ext == "opus")
+	{
+		return loadOpus(path);
+	}
+	std::cout << "Unsupported media file '" << path << "' (expected .h264 or .ogg)" << std::endl;
+	return nullptr;
+}
+
+std::shared_ptr<const MediaSource> MediaSource::loadH264(const std::string &path, double fps)
+{
+	auto source = std::make_shared<MediaSource>();
+	source->media_kind = Kind::H264;
+	source->file_name = path;
+	if (!readFile(path, source->buffer) || fps <= 0.0)
+	{
+		std::cout << "Failed to read H.264 file '" << path << "'" << std::endl;
+		return nullptr;
+	}
+
+	const auto *bytes = reinterpret_cast<const uint8_t *>(source->buffer.data());
+	size_t size = source->buffer.size();
+
+	// Split on start codes (00 00 01 or 00 00 00 01) and group NAL units into
+	// access units: a new one starts at an AUD, at SPS/PPS/SEI after a slice,
+	// or at a slice whose first_mb_in_slice is 0 (first ue(v) bit set)
+	size_t au_start = 0;
+	bool au_has_slice = false;
+	bool au_keyframe = false;
+	bool first = true;
+
+	auto closeAccessUnit = [&](size_t end)
+	{
+		if (!first && end > au_start)
+		{
+			int64_t pts = static_cast<int64_t>(source->frame_list.size() * 1000000.0 / fps);
+			source->frame_list.push_back({source->buffer.data() + au_start, end - au_start, pts, au_keyframe});
+		}
+	};
+
+	for (size_t i = 0; i + 3 < size; i++)
+	{
+		if (bytes[i] != 0 || bytes[i + 1] != 0 || bytes[i + 2] != 1)
+		{
+			continue;
+		}
+
+		size_t nal_start = (i > 0 && bytes[i - 1] == 0) ? i - 1 : i; // Include the long start code's extra zero
+		uint8_t type = bytes[i + 3] & 0x1F;
+		bool is_slice = type == 1 || type == 5;
+		bool first_slice = is_slice && i + 4 < size && (bytes[i + 4] & 0x80);
+		bool new_access_unit = first || type == 9 || (au_has_slice && (type == 6 || type == 7 || type == 8 || first_slice));
+
+		if (new_access_unit)
+		{
+			closeAccessUnit(nal_start);
+			au_start = nal_start;
+			au_has_slice = false;
+			au_keyframe = false;
+			first = false;
+		}
+		au_has_slice |= is_slice;
+		au_keyframe |= type == 5;
+		i += 2;
+	}
+	closeAccessUnit(size);
+
+	if (source->frame_list.empty())
+	{
+		std::cout << "No H.264 access units in '" << path << "'" << std::endl;
+		return nullptr;
+	}
+	source->duration_us = static_cast<int64_t>(source->frame_list.size() * 1000000.0 / fps);
+
+	std::cout << "Loaded " << path << ": " << source->frame_list.size() << " frames at " << fps << " fps" << std::endl;
+	return source;
+}
+
+// Duration of one Opus packet from its TOC byte (RFC 6716, section 3.1)
+static int64_t opusPacketMicros(const uint8_t *packet, size_t size)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	uint8_t config = packet[0] >> 3;
+	int64_t frame_us;
+	if (config < 12)
+	{
+		static const int64_t silk[] = {10000, 20000, 40000, 60000};
+		frame_us = silk[config % 4];
+	}
+	else if (config < 16)
+	{
+		frame_us = config % 2 == 0 ? 10000 : 20000;
+	}
+	else
+	{
+		static const int64_t celt[] = {2500, 5000, 10000, 20000};
+		frame_us = celt[config % 4];
+	}
+
+	int frames;
+	switch (packet[0] & 0x03)
+	{
+	case 0:
+		frames = 1;
+		break;
+	case 1:
+	case 2:
+		frames = 2;
+		break;
+	default:
+		frames = size > 1 ? (packet[1] & 0x3F) : 0;
+		break;
+	}
+	return frame_us * frames;
+}
+
+std::shared_ptr<const MediaSource> MediaSource::loadOpus(const std::string &path)
+{
+	auto source = std::make_shared<MediaSource>();
+	source->media_kind = Kind::Opus;
+	source->file_name = path;
+	if (!readFile(path, source->buffer))
+	{
+		std::cout << "Failed to read Ogg file '" << path << "'" << std::endl;
+		return nullptr;
+	}
+
+	const auto *bytes = reinterpret_cast<const uint8_t *>(source->buffer.data());
+	size_t size = source->buffer.size();
+
+	uint32_t serial = 0;
+	bool have_serial = false;
+	size_t packet_index = 0; // 0 = OpusHead, 1 = OpusTags, then audio
+	int64_t pts = 0;
+	std::vector<std::byte> partial; // Packet continued on the next page
+
+	auto addPacket = [&](const std::byte *data, size_t length, bool copied)
+	{
+		if (packet_index++ < 2)
+		{
+			return;
+		}
+		if (copied)
+		{
+			source->joined.emplace_back(data, data + length);
+			data = source->joined.back().data();
+		}
+		source->frame_list.push_back({data, length, pts, true});
+		pts += opusPacketMicros(reinterpret_cast<const uint8_t *>(data), length);
+	};
+
+	size_t pos = 0;
+	while (pos + 27 <= size)
+	{
+		if (std::memcmp(bytes + pos, "OggS", 4) != 0)
+		{
+			std::cout << "Corrupt Ogg page in '" << path << "' at offset " << pos << std::endl;
+			break;
+		}
+
+		uint32_t page_serial;
+		std::memcpy(&page_serial, bytes + pos + 14, 4);
+		uint8_t segments = bytes[pos + 26];
+		size_t body = pos + 27 + segments;
+		if (body > size)
+		{
+			break;
+		}
+
+		size_t body_size = 0;
+		for (uint8_t s = 0; s < segments; s++)
+		{
+			body_size += bytes[pos + 27 + s];
+		}
+		if (body + body_size > size)
+		{
+			break;
+		}
+
+		if (!have_serial)
+		{
+			serial = page_serial;
+			have_serial = true;
+		}
+
+		// Only the first logical stream
+		if (page_serial == serial)
+		{
+			size_t packet_start = body;
+			size_t offset = body;
+			for (uint8_t s = 0; s < segments; s++)
+			{
+				uint8_t lacing = bytes[pos + 27 + s];
+				offset += lacing;
+				if (lacing == 255)
+				{
+					continue;
+				}
+
+				const std::byte *data = source->buffer.data() + packet_start;
+				size_t length = offset - packet_start;
+				if (partial.empty())
+				{
+					addPacket(data, length, false);
+				}
+				else
+				{
+					partial.insert(partial.end(), data, data + length);
+					addPacket(partial.data(), partial.size(), true);
+					partial.clear();
+				}
+				packet_start = offset;
+			}
+
+			// Trailing 255 lacing values: the packet goes on in the next page
+			if (packet_start < offset)
+			{
+				partial.insert(partial.end(), source->buffer.data() + packet_start, source->buffer.data() + offset);
+			}
+		}
+
+		pos = body + body_size;
+	}
+
+	if (source->frame_list.empty())
+	{
+		std::cout << "No Opus packets in '" << path << "'" << std::endl;
+		return nullptr;
+	}
+	// Nothing would pace the streamer: every packet would be due at once, forever
+	if (pts <= 0)
+	{
+		std::cout << "Opus packets in '" << path << "' have no duration" << std::endl;
+		return nullptr;
+	}
+	source->duration_us = pts;
+
+	std::cout << "Loaded " << path << ": " << source->frame_list.size() << " Opus packets, " << pts / 1000 << " ms" << std::endl;
+	return source;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One encoded frame: an H.264 access unit (Annex-B, start codes included) or one Opus packet
+struct EncodedFrame
+{
+	const std::byte *data;
+	size_t size;
+	int64_t pts_us;		   // Presentation time from the start of the file
+	bool keyframe = false; // H.264: contains an IDR slice. Opus: always true
+};
+
+// A pre-encoded clip read into memory once. Frames are views into the file
+// buffer, so streaming the clip to any number of peers never copies it again.
+class MediaSource
+{
+public:
+	enum class Kind
+	{
+		H264,
+		Opus
+	};
+
+	// Picks the format from the extension: .h264/.264 (Annex-B) or .ogg/.opus (Ogg Opus)
+	static std::shared_ptr<const MediaSource> load(const std::string &path, double video_fps = 30.0);
+
+	static std::shared_ptr<const MediaSource> loadH264(const std::string &path, double fps);
+	static std::shared_ptr<const MediaSource> loadOpus(const std::string &path);
+
+	Kind kind() const { return media_kind; }
+	const std::string &name() const { return file_name; }
+	const std::vector<EncodedFrame> &frames() const { return frame_list; }
+	int64_t durationMicros() const { return duration_us; } // Loop period
+	size_t sizeBytes() const { return buffer.size(); }
+
+private:
+	Kind media_kind = Kind::H264;
+	std::string file_name;
+	std::vector<std::byte> buffer;
+	std::deque<std::vector<std::byte>> joined; // Opus packets split across Ogg pages, reassembled
+	std::vector<EncodedFrame> frame_list;
+	int64_t duration_us = 0;
+};
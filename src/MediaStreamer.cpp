@@ -0,0 +1,323 @@
+#include "MediaStreamer.h"
+
+#include <iostream>
+#include <random>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static constexpr int H264_PAYLOAD_TYPE = 96;
+static constexpr int OPUS_PAYLOAD_TYPE = 111;
+
+// Last handler in the chain: sees the final RTP packets (and RTCP, which is not counted)
+class PacketCounter : public rtc::MediaHandler
+{
+public:
+	PacketCounter(std::shared_ptr<std::atomic<uint64_t>> packets, std::shared_ptr<std::atomic<uint64_t>> bytes)
+		: packets(std::move(packets)), bytes(std::move(bytes))
+	{
+	}
+
+	void outgoing(rtc::message_vector &messages, [[maybe_unused]] const rtc::message_callback &send) override
+	{
+		for (const auto &message : messages)
+		{
+			if (message && message->type == rtc::Message::Binary)
+			{
+				packets->fetch_add(1, std::memory_order_relaxed);
+				bytes->fetch_add(message->size(), std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	std::shared_ptr<std::atomic<uint64_t>> packets;
+	std::shared_ptr<std::atomic<uint64_t>> bytes;
+};
+
+int64_t MediaStreamer::threadCpuMicros()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+	{
+		return 0;
+	}
+	auto ticks = [](const FILETIME &time)
+	{ return (static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+	return (ticks(kernel) + ticks(user)) / 10; // 100 ns units
+#else
+	timespec now{};
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+MediaStreamer::MediaStreamer(std::shared_ptr<const MediaSource> source, std::string mid)
+	: source(std::move(source)), media_id(std::move(mid))
+{
+}
+
+MediaStreamer::~MediaStreamer()
+{
+	stop();
+}
+
+void MediaStreamer::start()
+{
+	if (running.exchange(true))
+	{
+		return;
+	}
+	thread = std::thread(&MediaStreamer::run, this);
+	std::cout << "Streaming " << source->name() << " as '" << media_id << "'" << std::endl;
+}
+
+void MediaStreamer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		running = false;
+	}
+	wake.notify_all();
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+bool MediaStreamer::attach(const std::string &peer_id, const std::shared_ptr<rtc::PeerConnection> &pc)
+{
+	static std::mt19937 ssrc_rng{std::random_device{}()};
+
+	auto sink = std::make_shared<Sink>();
+	sink->peer_id = peer_id;
+	sink->pc = pc;
+
+	uint32_t ssrc;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ssrc = ssrc_rng();
+	}
+	std::string cname = "stream-" + media_id;
+
+	try
+	{
+		std::shared_ptr<rtc::MediaHandler> packetizer;
+		if (source->kind() == MediaSource::Kind::H264)
+		{
+			rtc::Description::Video media(media_id, rtc::Description::Direction::SendOnly);
+			media.addH264Codec(H264_PAYLOAD_TYPE);
+			media.addSSRC(ssrc, cname, cname, media_id);
+			sink->track = pc->addTrack(media);
+			sink->rtp = std::make_shared<rtc::RtpPacketizationConfig>(ssrc, cname, H264_PAYLOAD_TYPE, rtc::H264RtpPacketizer::defaultClockRate);
+			packetizer = std::make_shared<rtc::H264RtpPacketizer>(rtc::NalUnit::Separator::StartSequence, sink->rtp);
+		}
+		else
+		{
+			rtc::Description::Audio media(media_id, rtc::Description::Direction::SendOnly);
+			media.addOpusCodec(OPUS_PAYLOAD_TYPE);
+			media.addSSRC(ssrc, cname, cname, media_id);
+			sink->track = pc->addTrack(media);
+			sink->rtp = std::make_shared<rtc::RtpPacketizationConfig>(ssrc, cname, OPUS_PAYLOAD_TYPE, rtc::OpusRtpPacketizer::DefaultClockRate);
+			packetizer = std::make_shared<rtc::OpusRtpPacketizer>(sink->rtp);
+		}
+
+		packetizer->addToChain(std::make_shared<rtc::RtcpSrReporter>(sink->rtp));
+		packetizer->addToChain(std::make_shared<rtc::RtcpNackResponder>());
+		packetizer->addToChain(std::make_shared<PacketCounter>(
+			std::shared_ptr<std::atomic<uint64_t>>(counters, &counters->packets),
+			std::shared_ptr<std::atomic<uint64_t>>(counters, &counters->bytes)));
+		sink->track->setMediaHandler(packetizer);
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "Failed to add " << media_id << " track for " << peer_id << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	sinks[peer_id] = sink;
+	auto snapshot = std::make_shared<SinkList>();
+	for (const auto &[id, entry] : sinks)
+	{
+		snapshot->push_back(entry);
+	}
+	sink_snapshot = snapshot;
+	return true;
+}
+
+bool MediaStreamer::isAttached(const std::string &peer_id, const std::shared_ptr<rtc::PeerConnection> &pc) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = sinks.find(peer_id);
+	return it != sinks.end() && it->second->pc.lock() == pc;
+}
+
+void MediaStreamer::detach(const std::string &peer_id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (sinks.erase(peer_id) == 0)
+	{
+		return;
+	}
+	auto snapshot = std::make_shared<SinkList>();
+	for (const auto &[id, entry] : sinks)
+	{
+		snapshot->push_back(entry);
+	}
+	sink_snapshot = snapshot;
+}
+
+std::vector<std::pair<std::string, std::shared_ptr<rtc::PeerConnection>>> MediaStreamer::closeTracks()
+{
+	std::unordered_map<std::string, std::shared_ptr<Sink>> closing;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing.swap(sinks);
+		sink_snapshot = std::make_shared<SinkList>();
+	}
+
+	std::vector<std::pair<std::string, std::shared_ptr<rtc::PeerConnection>>> connections;
+	for (const auto &[peer_id, sink] : closing)
+	{
+		try
+		{
+			sink->track->close();
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Failed to close " << media_id << " track for " << peer_id << ": " << e.what() << std::endl;
+		}
+		if (auto pc = sink->pc.lock())
+		{
+			connections.emplace_back(peer_id, std::move(pc));
+		}
+	}
+	return connections;
+}
+
+MediaStreamStats MediaStreamer::stats() const
+{
+	MediaStreamStats result;
+	result.name = source->name();
+	result.mid = media_id;
+	result.frames_sent = frames_sent.load();
+	result.packets_sent = counters->packets.load();
+	result.bytes_sent = counters->bytes.load();
+	result.loops = loops.load();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	result.peers = sinks.size();
+	result.packets_per_sec = packets_per_sec;
+	result.cpu_percent = cpu_percent;
+	return result;
+}
+
+void MediaStreamer::sendFrame(const EncodedFrame &frame, int64_t loop_offset_us)
+{
+	std::shared_ptr<const SinkList> targets;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		targets = sink_snapshot;
+	}
+
+	double seconds = static_cast<double>(loop_offset_us + frame.pts_us) / 1000000.0;
+	for (const auto &sink : *targets)
+	{
+		if (!sink->track->isOpen())
+		{
+			continue;
+		}
+
+		// Peers that join mid-clip start at the next IDR
+		if (sink->waiting_for_keyframe && !frame.keyframe)
+		{
+			continue;
+		}
+		sink->waiting_for_keyframe = false;
+
+		try
+		{
+			sink->rtp->timestamp = sink->rtp->startTimestamp + sink->rtp->secondsToTimestamp(seconds);
+			sink->track->send(frame.data, frame.size);
+			frames_sent.fetch_add(1, std::memory_order_relaxed);
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Media send to " << sink->peer_id << " failed: " << e.what() << std::endl;
+		}
+	}
+}
+
+void MediaStreamer::run()
+{
+	const auto &frames = source->frames();
+	if (frames.empty() || source->durationMicros() <= 0)
+	{
+		std::cout << "Not streaming '" << source->name() << "': clip has no duration" << std::endl;
+		return;
+	}
+
+	Clock::time_point start = Clock::now();
+	size_t index = 0;
+	int64_t loop_offset_us = 0;
+
+	Clock::time_point window_start = start;
+	int64_t window_cpu = threadCpuMicros();
+	uint64_t window_packets = counters->packets.load();
+
+	while (running)
+	{
+		const EncodedFrame &frame = frames[index];
+		Clock::time_point due = start + std::chrono::microseconds(loop_offset_us + frame.pts_us);
+
+		// After a stall (suspended process, debugger) pick up from now rather
+		// than sending everything that fell due back to back
+		Clock::time_point current = Clock::now();
+		if (current - due > std::chrono::seconds(1))
+		{
+			start += current - due;
+			due = current;
+		}
+		{
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			if (wake.wait_until(lock, due, [this]()
+								{ return !running; }))
+			{
+				break;
+			}
+		}
+
+		sendFrame(frame, loop_offset_us);
+
+		if (++index == frames.size())
+		{
+			index = 0;
+			loop_offset_us += source->durationMicros();
+			loops++;
+		}
+
+		// Rates over roughly one second
+		Clock::time_point now = Clock::now();
+		if (now - window_start >= std::chrono::seconds(1))
+		{
+			double elapsed_us = std::chrono::duration<double, std::micro>(now - window_start).count();
+			int64_t cpu = threadCpuMicros();
+			uint64_t packets = counters->packets.load();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			packets_per_sec = static_cast<double>(packets - window_packets) * 1000000.0 / elapsed_us;
+			cpu_percent = static_cast<double>(cpu - window_cpu) * 100.0 / elapsed_us;
+			window_start = now;
+			window_cpu = cpu;
+			window_packets = packets;
+		}
+	}
+}
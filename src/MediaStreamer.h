@@ -0,0 +1,104 @@
+#pragma once
+
+#include "rtc/rtc.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "MediaSource.h"
+
+struct MediaStreamStats
+{
+	std::string name;
+	std::string mid;
+	size_t peers = 0;
+	uint64_t frames_sent = 0; // Counted once per peer
+	uint64_t packets_sent = 0; // RTP packets after packetization, all peers
+	uint64_t bytes_sent = 0;
+	uint64_t loops = 0;
+	double packets_per_sec = 0.0;
+	double cpu_percent = 0.0; // Pacing thread, which also runs packetization and SRTP
+};
+
+// Streams one pre-encoded clip to every attached peer on its own pacing thread.
+//
+// Each peer gets a send-only track whose handler chain is
+//   packetizer (H.264 or Opus) -> RTCP SR reporter -> NACK responder -> packet counter.
+// Frames are views into the shared MediaSource until they are sent: each
+// peer's track copies the frame into its own message, which that peer's
+// packetizer then splits into RTP packets. The clip loops until stopped.
+class MediaStreamer
+{
+public:
+	MediaStreamer(std::shared_ptr<const MediaSource> source, std::string mid);
+	~MediaStreamer();
+
+	MediaStreamer(const MediaStreamer &) = delete;
+	MediaStreamer &operator=(const MediaStreamer &) = delete;
+
+	void start();
+	void stop();
+
+	// Adds this stream's track to pc (the caller renegotiates). Replaces the
+	// track of an earlier connection to the same peer.
+	bool attach(const std::string &peer_id, const std::shared_ptr<rtc::PeerConnection> &pc);
+	bool isAttached(const std::string &peer_id, const std::shared_ptr<rtc::PeerConnection> &pc) const;
+	void detach(const std::string &peer_id);
+	// Closes every peer's track, so the next offer on each connection marks the
+	// m-line removed. Returns the connections that need that offer.
+	std::vector<std::pair<std::string, std::shared_ptr<rtc::PeerConnection>>> closeTracks();
+
+	const std::string &mid() const { return media_id; }
+	MediaStreamStats stats() const;
+
+	// CPU time consumed by the calling thread
+	static int64_t threadCpuMicros();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Sink
+	{
+		std::string peer_id;
+		std::weak_ptr<rtc::PeerConnection> pc;
+		std::shared_ptr<rtc::Track> track;
+		std::shared_ptr<rtc::RtpPacketizationConfig> rtp;
+		bool waiting_for_keyframe = true; // Pacing thread only
+	};
+	using SinkList = std::vector<std::shared_ptr<Sink>>;
+
+	// Shared with the counting handlers, which may outlive the streamer
+	struct Counters
+	{
+		std::atomic<uint64_t> packets{0};
+		std::atomic<uint64_t> bytes{0};
+	};
+
+	void run();
+	void sendFrame(const EncodedFrame &frame, int64_t loop_offset_us);
+
+	std::shared_ptr<const MediaSource> source;
+	std::string media_id;
+	std::shared_ptr<Counters> counters = std::make_shared<Counters>();
+
+	mutable std::mutex mutex; // Guards sinks and the rate figures
+	std::unordered_map<std::string, std::shared_ptr<Sink>> sinks;
+	std::shared_ptr<const SinkList> sink_snapshot = std::make_shared<SinkList>(); // Copy-on-write view for the pacing thread
+	double packets_per_sec = 0.0;
+	double cpu_percent = 0.0;
+
+	std::atomic<uint64_t> frames_sent{0};
+	std::atomic<uint64_t> loops{0};
+
+	std::atomic<bool> running{false};
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::thread thread;
+};
@@ -0,0 +1,100 @@
+#include "MessageCoalescer.h"
+
+#include <algorithm>
+
+MessageCoalescer::MessageCoalescer(Clock::duration min_window, Clock::duration max_window, size_t max_bytes)
+	: min_window(min_window), max_window(max_window), current_window(max_window), max_bytes(max_bytes), smoothed_gap(max_window * 4)
+{
+}
+
+void MessageCoalescer::setRtt(Clock::duration rtt)
+{
+	current_window = std::clamp(rtt / 10, min_window, max_window);
+}
+
+std::vector<std::string> MessageCoalescer::add(std::string frame, Clock::time_point now)
+{
+	std::vector<std::string> out;
+
+	// A batch whose window expired, or that cannot take this frame within the
+	// byte budget, goes out first so frames stay in order
+	if (!pending.empty() && (now - first_pending >= pending_window || pending_bytes + frame.size() + 1 > max_bytes))
+	{
+		out.push_back(takeBatch());
+	}
+
+	// Exponentially smoothed inter-frame gap. Samples are capped so a long idle
+	// period does not take many frames to recover from once a burst starts.
+	Clock::duration gap = seen_frame ? std::min(now - last_add, max_window * 4) : smoothed_gap;
+	smoothed_gap = smoothed_gap - smoothed_gap / 4 + gap / 4;
+	last_add = now;
+	seen_frame = true;
+
+	bool busy = smoothed_gap * 2 <= current_window;
+	if (pending.empty() && !busy)
+	{
+		out.push_back(std::move(frame));
+		return out;
+	}
+
+	if (pending.empty())
+	{
+		first_pending = now;
+		pending_window = current_window;
+	}
+	pending_bytes += frame.size() + 1;
+	pending.push_back(std::move(frame));
+
+	// Exactly full, or a single frame that is over the budget on its own
+	if (pending_bytes >= max_bytes)
+	{
+		out.push_back(takeBatch());
+	}
+	return out;
+}
+
+std::optional<MessageCoalescer::Clock::time_point> MessageCoalescer::deadline() const
+{
+	if (pending.empty())
+	{
+		return std::nullopt;
+	}
+	return first_pending + pending_window;
+}
+
+std::optional<std::string> MessageCoalescer::flush(Clock::time_point now, bool force)
+{
+	if (pending.empty() || (!force && now - first_pending < pending_window))
+	{
+		return std::nullopt;
+	}
+	return takeBatch();
+}
+
+std::string MessageCoalescer::takeBatch()
+{
+	std::string batch;
+	if (pending.size() == 1)
+	{
+		batch = std::move(pending.front());
+	}
+	else
+	{
+		// Frames are already JSON objects, so they can be spliced in as-is
+		batch.reserve(pending_bytes + 32);
+		batch = "{\"type\":\"batch\",\"frames\":[";
+		for (size_t i = 0; i < pending.size(); i++)
+		{
+			if (i > 0)
+			{
+				batch += ',';
+			}
+			batch += pending[i];
+		}
+		batch += "]}";
+	}
+
+	pending.clear();
+	pending_bytes = 0;
+	return batch;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Packs data-channel frames that are sent in quick succession into a single
+// "batch" frame:  {"type":"batch","frames":[<frame>,<frame>,...]}
+//
+// The window follows the link: a tenth of the measured round-trip time, kept
+// between min_window and max_window (max_window until an RTT is known), so the
+// delay batching adds stays small next to the delay the network adds anyway.
+// The send rate decides whether to batch at all: the link is treated as idle
+// unless the smoothed gap between frames lets at least two of them into one
+// window. Idle frames go out immediately, so latency is unchanged at low rates.
+// During a burst frames are held until the window expires, the byte budget
+// would be exceeded, or the owner forces a flush. The owner is expected to call
+// flush() at deadline(); add() also releases an expired batch.
+class MessageCoalescer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	MessageCoalescer(Clock::duration min_window = std::chrono::microseconds(500), Clock::duration max_window = std::chrono::milliseconds(5),
+					 size_t max_bytes = 16 * 1024);
+
+	// Latest round-trip estimate for the peer; sizes the window of the next batch
+	void setRtt(Clock::duration rtt);
+	Clock::duration window() const { return current_window; }
+
+	// Returns the wire messages to send right away, in order (often none)
+	std::vector<std::string> add(std::string frame, Clock::time_point now);
+
+	// Returns the pending batch once its window expired (or unconditionally with force)
+	std::optional<std::string> flush(Clock::time_point now, bool force = false);
+
+	bool hasPending() const { return !pending.empty(); }
+
+	// When the pending batch is due, std::nullopt if nothing is held
+	std::optional<Clock::time_point> deadline() const;
+
+private:
+	std::string takeBatch();
+
+	Clock::duration min_window;
+	Clock::duration max_window;
+	Clock::duration current_window;
+	size_t max_bytes;
+
+	std::vector<std::string> pending;
+	size_t pending_bytes = 0;
+	Clock::time_point first_pending;
+	Clock::duration pending_window{}; // Window of the batch being held
+
+	Clock::time_point last_add;
+	Clock::duration smoothed_gap;
+
+	bool seen_frame = false;
+};
+
+// Aggregate batching figures across all peers
+struct CoalescingStats
+{
+	uint64_t frames = 0;		// frames handed to the coalescers
+	uint64_t wire_messages = 0; // data-channel messages actually sent for them
+
+	double batchingFactor() const { return wire_messages ? static_cast<double>(frames) / static_cast<double>(wire_messages) : 1.0; }
+};
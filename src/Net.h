@@ -0,0 +1,58 @@
+#pragma once
+
+// Thin portability layer over BSD sockets / Winsock for the UDP helpers
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+using socket_t = SOCKET;
+using pollfd_t = WSAPOLLFD;
+inline constexpr socket_t INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+
+namespace net
+{
+	inline bool init()
+	{
+		static const bool ok = []()
+		{
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		return ok;
+	}
+	inline void closeSocket(socket_t s) { closesocket(s); }
+	inline int poll(pollfd_t *fds, size_t count, int timeout_ms) { return WSAPoll(fds, static_cast<ULONG>(count), timeout_ms); }
+	inline bool setNonBlocking(socket_t s)
+	{
+		u_long mode = 1;
+		return ioctlsocket(s, FIONBIO, &mode) == 0;
+	}
+}
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using socket_t = int;
+using pollfd_t = struct pollfd;
+inline constexpr socket_t INVALID_SOCKET_HANDLE = -1;
+
+namespace net
+{
+	inline bool init() { return true; }
+	inline void closeSocket(socket_t s) { ::close(s); }
+	inline int poll(pollfd_t *fds, size_t count, int timeout_ms) { return ::poll(fds, static_cast<nfds_t>(count), timeout_ms); }
+	inline bool setNonBlocking(socket_t s)
+	{
+		int flags = fcntl(s, F_GETFL, 0);
+		return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+}
+#endif
@@ -0,0 +1,65 @@
+#include "ProcessStats.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+ProcessStats ProcessStats::sample()
+{
+	ProcessStats stats;
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS memory{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+	{
+		stats.rss_bytes = memory.WorkingSetSize;
+	}
+	DWORD handles = 0;
+	if (GetProcessHandleCount(GetCurrentProcess(), &handles))
+	{
+		stats.open_fds = handles;
+	}
+#else
+	// RUSAGE_SELF sums the context switches of every thread
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		stats.context_switches = static_cast<uint64_t>(usage.ru_nvcsw) + static_cast<uint64_t>(usage.ru_nivcsw);
+	}
+
+	// The rest comes from procfs (Linux); elsewhere it stays 0
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	if (statm >> pages >> resident)
+	{
+		stats.rss_bytes = resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	}
+
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.rfind("Threads:", 0) == 0)
+		{
+			stats.threads = std::stoul(line.substr(8));
+			break;
+		}
+	}
+
+	std::error_code error;
+	for (std::filesystem::directory_iterator it("/proc/self/fd", error), end; !error && it != end; it.increment(error))
+	{
+		stats.open_fds++;
+	}
+#endif
+	return stats;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Process-wide resource usage, sampled on demand. Fields the platform cannot
+// report stay 0 (thread count and context switches on Windows).
+struct ProcessStats
+{
+	size_t rss_bytes = 0;
+	size_t open_fds = 0; // Handles on Windows
+	size_t threads = 0;
+	uint64_t context_switches = 0; // Voluntary + involuntary, all threads since start
+
+	static ProcessStats sample();
+};
+
+// Process cost of the peer mesh, normalized so runs with different peer counts compare
+struct ResourceReport
+{
+	ProcessStats process;
+	double wakeups_per_sec = 0.0; // Context switches per second over the last sampling window
+	size_t live_peers = 0;		  // Peers with an open connection
+	size_t hibernated_peers = 0;  // Closed but remembered
+
+	// Per 100 known peers (live + hibernated), 0 without peers
+	double per100Peers(double value) const
+	{
+		size_t peers = live_peers + hibernated_peers;
+		return peers ? value * 100.0 / static_cast<double>(peers) : 0.0;
+	}
+};
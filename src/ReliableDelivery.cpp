@@ -0,0 +1,149 @@
+#include "ReliableDelivery.h"
+
+#include <random>
+
+static uint64_t newEpoch()
+{
+	static std::mt19937_64 rng{std::random_device{}()};
+	uint64_t epoch;
+	do
+	{
+		epoch = rng();
+	} while (epoch == 0); // 0 means "none seen yet" on the wire
+	return epoch;
+}
+
+ReliableSession::ReliableSession(size_t max_messages, size_t max_bytes)
+	: max_messages(max_messages), max_bytes(max_bytes), local_epoch(newEpoch())
+{
+}
+
+bool ReliableSession::canEnqueue(size_t payload_bytes) const
+{
+	// A single message larger than the byte budget still goes through an empty buffer
+	if (retransmit_buffer.empty())
+	{
+		return true;
+	}
+	return retransmit_buffer.size() < max_messages && buffered_bytes + payload_bytes <= max_bytes;
+}
+
+uint64_t ReliableSession::enqueue(std::string payload, int64_t now_us, uint64_t history_id, int64_t history_ts_us)
+{
+	// Memory stays bounded by pushing back on the sender, never by dropping unacked data
+	if (!canEnqueue(payload.size()))
+	{
+		counters.refused++;
+		return 0;
+	}
+
+	uint64_t seq = next_seq++;
+	buffered_bytes += payload.size();
+	retransmit_buffer.push_back({seq, now_us, std::move(payload), history_id, history_ts_us});
+	counters.sent++;
+	return seq;
+}
+
+bool ReliableSession::onResume(uint64_t peer_epoch, uint64_t echoed_epoch, uint64_t ack)
+{
+	bool restarted = remote_epoch != 0 && peer_epoch != remote_epoch;
+	if (restarted)
+	{
+		// The peer dropped the old session and expects seq 1 next: what it had not
+		// acked leads the new stream, and its own stream to us starts over
+		counters.carried_over += retransmit_buffer.size();
+		counters.restarts++;
+		next_seq = 1;
+		for (auto &out : retransmit_buffer)
+		{
+			out.seq = next_seq++;
+		}
+		recv_seq = 0;
+		last_ack_sent = 0;
+	}
+	remote_epoch = peer_epoch;
+	link_ready = true;
+
+	// An ack for another epoch of ours says nothing about this stream
+	if (echoed_epoch == local_epoch)
+	{
+		onAck(ack);
+	}
+	return restarted;
+}
+
+void ReliableSession::onAck(uint64_t ack)
+{
+	// Before the peer's resume we cannot tell which epoch the ack is for
+	if (!link_ready)
+	{
+		return;
+	}
+	while (!retransmit_buffer.empty() && retransmit_buffer.front().seq <= ack)
+	{
+		buffered_bytes -= retransmit_buffer.front().payload.size();
+		retransmit_buffer.pop_front();
+		counters.acked++;
+	}
+}
+
+void ReliableSession::markRetransmitted(size_t count)
+{
+	counters.retransmitted += count;
+}
+
+ReliableSession::ReceiveResult ReliableSession::onData(uint64_t seq, Clock::time_point now)
+{
+	// Before the peer's resume we do not know which of its sessions this belongs to
+	if (!link_ready)
+	{
+		counters.out_of_order++;
+		return ReceiveResult::OutOfOrder;
+	}
+
+	if (seq <= recv_seq)
+	{
+		counters.duplicates++;
+		return ReceiveResult::Duplicate;
+	}
+
+	// Only the next message in order is delivered; anything past a gap was
+	// preceded by a loss and comes again when the sender retransmits
+	if (seq > recv_seq + 1)
+	{
+		counters.out_of_order++;
+		return ReceiveResult::OutOfOrder;
+	}
+
+	if (recv_seq == last_ack_sent)
+	{
+		first_unacked_recv = now;
+	}
+	recv_seq = seq;
+	counters.delivered++;
+	return ReceiveResult::Deliver;
+}
+
+bool ReliableSession::ackDue(Clock::time_point now) const
+{
+	uint64_t pending = recv_seq - last_ack_sent;
+	if (pending == 0)
+	{
+		return false;
+	}
+	return pending >= ACK_EVERY || now - first_unacked_recv >= ACK_DELAY;
+}
+
+uint64_t ReliableSession::takeAck()
+{
+	last_ack_sent = recv_seq;
+	return recv_seq;
+}
+
+DeliveryStats ReliableSession::stats() const
+{
+	DeliveryStats result = counters;
+	result.buffered_messages = retransmit_buffer.size();
+	result.buffered_bytes = buffered_bytes;
+	return result;
+}
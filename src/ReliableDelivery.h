@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Counters for one peer's delivery session, exposed for stress testing and the UI
+struct DeliveryStats
+{
+	uint64_t sent = 0;			 // messages handed to the session
+	uint64_t retransmitted = 0;	 // messages re-sent after a reconnect
+	uint64_t acked = 0;			 // messages confirmed by the peer
+	uint64_t delivered = 0;		 // messages received and passed on to the app
+	uint64_t duplicates = 0;	 // received messages dropped as already seen
+	uint64_t refused = 0;		 // sends turned away because the buffer was full (the caller keeps them)
+	uint64_t out_of_order = 0;	 // received past a gap or before the resume and dropped; resent on the next resume
+	uint64_t carried_over = 0;	 // unacked messages moved into a session the peer started over
+	uint64_t restarts = 0;		 // times the peer came back with a new session epoch
+	size_t buffered_messages = 0;
+	size_t buffered_bytes = 0;
+};
+
+// Per-peer sequencing state for reliable delivery over a data channel.
+// A session outlives the data channel it runs over: when the peer reconnects,
+// both sides exchange their last received sequence number and the sender
+// retransmits whatever is still unacknowledged.
+//
+// Nothing unacknowledged is ever dropped: once the retransmit buffer is full,
+// enqueue() refuses new messages until acks make room.
+//
+// Every session has a random epoch that travels in the resume frame. A peer
+// that forgot the session (explicit disconnect, restart) comes back with a new
+// epoch; the other side then starts its half over as well, so neither side
+// mistakes the new conversation for duplicates of the old one. What the peer
+// had not acked is renumbered into the new stream and sent again: it cannot be
+// told apart from messages the peer received but never acked, so across a
+// restart delivery is at least once rather than exactly once.
+class ReliableSession
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Outgoing
+	{
+		uint64_t seq;
+		int64_t enqueued_us; // Sender clock when the app sent it; travels with every (re)transmission
+		std::string payload;
+		uint64_t history_id; // Shared chat history entry this message carries, 0 if private
+		int64_t history_ts_us; // That entry's wall-clock timestamp
+	};
+
+	enum class ReceiveResult
+	{
+		Deliver,
+		Duplicate,
+		OutOfOrder // Past a gap or before the peer's resume: dropped, resent after the next resume
+	};
+
+	ReliableSession(size_t max_messages = 1024, size_t max_bytes = 1024 * 1024);
+
+	// Sender side
+	// Assigns the next sequence number and buffers the message; 0 when the buffer is full
+	// (the message is not taken, try again once the peer has acked)
+	uint64_t enqueue(std::string payload, int64_t now_us, uint64_t history_id = 0, int64_t history_ts_us = 0);
+	bool canEnqueue(size_t payload_bytes) const;
+	void onAck(uint64_t ack);			   // Cumulative: everything <= ack has been received
+	void markRetransmitted(size_t count);
+	const std::deque<Outgoing> &unacked() const { return retransmit_buffer; }
+
+	// Receiver side
+	ReceiveResult onData(uint64_t seq, Clock::time_point now = Clock::now());
+	uint64_t receivedSeq() const { return recv_seq; }
+	bool ackDue(Clock::time_point now) const;
+	uint64_t takeAck(); // Returns the ack to send and marks it as sent
+
+	// Resume handshake: 'peer_epoch' is the epoch the peer sent, 'echoed_epoch' the one it
+	// last saw from us; its ack only counts if that is our current epoch. Returns true when
+	// the peer started a new session, in which case this one was reset to match and the
+	// unacked messages renumbered from 1 (resend them as usual). Marks the link ready:
+	// data and acks that arrive before the peer's resume are ignored.
+	uint64_t epoch() const { return local_epoch; }
+	uint64_t peerEpoch() const { return remote_epoch; }
+	bool onResume(uint64_t peer_epoch, uint64_t echoed_epoch, uint64_t ack);
+
+	// Channel state: new messages are only sent once the peer's resume has arrived
+	void setLinkReady(bool ready) { link_ready = ready; }
+	bool isLinkReady() const { return link_ready; }
+
+	DeliveryStats stats() const;
+
+	static constexpr uint64_t ACK_EVERY = 8;
+	static constexpr std::chrono::milliseconds ACK_DELAY{20};
+
+private:
+	size_t max_messages;
+	size_t max_bytes;
+
+	uint64_t next_seq = 1;
+	std::deque<Outgoing> retransmit_buffer;
+	size_t buffered_bytes = 0;
+
+	uint64_t local_epoch;
+	uint64_t remote_epoch = 0; // 0 until the peer's first resume
+
+	uint64_t recv_seq = 0;		// Highest sequence number delivered to the app
+	uint64_t last_ack_sent = 0; // Highest ack we have told the peer about
+	Clock::time_point first_unacked_recv;
+
+	bool link_ready = false;
+	DeliveryStats counters;
+};
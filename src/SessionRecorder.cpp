@@ -0,0 +1,194 @@
+#include "SessionRecorder.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+static constexpr char MAGIC[8] = {'W', 'R', 'T', 'C', 'R', 'E', 'C', '1'};
+
+static void writeVarint(std::ofstream &out, uint64_t value)
+{
+	char bytes[10];
+	size_t count = 0;
+	do
+	{
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+		bytes[count++] = static_cast<char>(value ? byte | 0x80 : byte);
+	} while (value);
+	out.write(bytes, static_cast<std::streamsize>(count));
+}
+
+static void writeString(std::ofstream &out, std::string_view text)
+{
+	writeVarint(out, text.size());
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+static bool readVarint(const std::string &data, size_t &pos, uint64_t &value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && pos < data.size(); shift += 7)
+	{
+		uint8_t byte = static_cast<uint8_t>(data[pos++]);
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool readString(const std::string &data, size_t &pos, std::string &out)
+{
+	uint64_t length;
+	if (!readVarint(data, pos, length) || length > data.size() - pos)
+	{
+		return false;
+	}
+	out.assign(data, pos, length);
+	pos += length;
+	return true;
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	close();
+}
+
+bool SessionRecorder::open(const std::string &path, const std::string &client_id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	buffer.resize(1 << 16);
+	file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "Cannot open session trace '" << path << "' for writing" << std::endl;
+		return false;
+	}
+
+	file.write(MAGIC, sizeof(MAGIC));
+	writeString(file, client_id);
+	start = Clock::now();
+	last_us = 0;
+	events = 0;
+	std::cout << "Recording session to " << path << std::endl;
+	return true;
+}
+
+void SessionRecorder::close()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file.is_open())
+	{
+		file.close();
+		std::cout << "Session trace closed (" << events << " events)" << std::endl;
+	}
+}
+
+bool SessionRecorder::isOpen() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return file.is_open();
+}
+
+void SessionRecorder::record(SessionEventKind kind, std::string_view peer, std::string_view payload)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	// Timestamp taken under the lock so deltas never go negative across threads
+	int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+	file.put(static_cast<char>(kind));
+	writeVarint(file, static_cast<uint64_t>(now_us - last_us));
+	writeString(file, peer);
+	writeString(file, payload);
+	last_us = now_us;
+	events++;
+}
+
+bool SessionReplayer::load(const std::string &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Cannot open session trace '" << path << "'" << std::endl;
+		return false;
+	}
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+	{
+		std::cout << "'" << path << "' is not a session trace" << std::endl;
+		return false;
+	}
+
+	size_t pos = sizeof(MAGIC);
+	if (!readString(data, pos, client_id))
+	{
+		std::cout << "Truncated session trace header in '" << path << "'" << std::endl;
+		return false;
+	}
+
+	events.clear();
+	int64_t t_us = 0;
+	while (pos < data.size())
+	{
+		SessionEvent event;
+		uint8_t kind = static_cast<uint8_t>(data[pos++]);
+		uint64_t delta;
+		if (kind < static_cast<uint8_t>(SessionEventKind::Signaling) || kind > static_cast<uint8_t>(SessionEventKind::ChannelClosed) ||
+			!readVarint(data, pos, delta) || !readString(data, pos, event.peer) || !readString(data, pos, event.payload))
+		{
+			// A recording cut short by a crash still replays up to the damage
+			std::cout << "Session trace '" << path << "' damaged after " << events.size() << " events" << std::endl;
+			break;
+		}
+		t_us += static_cast<int64_t>(delta);
+		event.kind = static_cast<SessionEventKind>(kind);
+		event.t_us = t_us;
+		events.push_back(std::move(event));
+	}
+
+	// Replay starts at the first event, not at the moment the recording was opened
+	if (!events.empty())
+	{
+		int64_t first_us = events.front().t_us;
+		for (auto &event : events)
+		{
+			event.t_us -= first_us;
+		}
+		t_us -= first_us;
+	}
+
+	next = 0;
+	std::cout << "Loaded session trace " << path << ": " << events.size() << " events over " << t_us / 1000 << " ms" << std::endl;
+	return true;
+}
+
+void SessionReplayer::start(double speed, Clock::time_point now)
+{
+	replay_speed = speed;
+	started = now;
+	next = 0;
+}
+
+std::vector<SessionEvent> SessionReplayer::poll(Clock::time_point now, size_t max_events)
+{
+	std::vector<SessionEvent> due;
+	double elapsed_us = std::chrono::duration<double, std::micro>(now - started).count();
+	while (next < events.size() && due.size() < max_events)
+	{
+		if (replay_speed > 0.0 && static_cast<double>(events[next].t_us) > elapsed_us * replay_speed)
+		{
+			break;
+		}
+		due.push_back(std::move(events[next++]));
+	}
+	return due;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What a session trace captures: everything the client reacts to from outside
+enum class SessionEventKind : uint8_t
+{
+	Signaling = 1,	// Inbound signaling message (peer empty)
+	ChannelOpen,	// Data channel to peer opened
+	ChannelMessage, // Text message received on peer's data channel
+	ChannelClosed
+};
+
+struct SessionEvent
+{
+	SessionEventKind kind;
+	int64_t t_us; // Since the first event of the recording
+	std::string peer;
+	std::string payload;
+};
+
+// Writes a session trace. File layout:
+//   "WRTCREC1" <client id>
+//   then per event: [kind:u8][dt:varint][peer:string][payload:string]
+// where dt is microseconds since the previous event and strings are a
+// varint length followed by the bytes. Safe to call from any thread.
+class SessionRecorder
+{
+public:
+	~SessionRecorder();
+
+	bool open(const std::string &path, const std::string &client_id);
+	void close();
+	bool isOpen() const;
+
+	void record(SessionEventKind kind, std::string_view peer, std::string_view payload);
+	uint64_t eventCount() const { return events; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	mutable std::mutex mutex;
+	std::ofstream file;
+	std::vector<char> buffer; // Stream buffer, so small events do not hit the disk one by one
+	Clock::time_point start;
+	int64_t last_us = 0;
+	std::atomic<uint64_t> events{0};
+};
+
+// Plays a session trace back with the original timing scaled by a speed factor
+class SessionReplayer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	bool load(const std::string &path);
+	const std::string &clientId() const { return client_id; }
+
+	// speed 1 = original timing, 10 = ten times faster, 0 = as fast as possible
+	void start(double speed, Clock::time_point now);
+	double speed() const { return replay_speed; }
+
+	// Events due by now, in recorded order. At most max_events per call so the UI keeps drawing frames.
+	std::vector<SessionEvent> poll(Clock::time_point now, size_t max_events = 1000);
+
+	size_t position() const { return next; }
+	size_t size() const { return events.size(); }
+	bool finished() const { return next >= events.size(); }
+
+private:
+	std::string client_id;
+	std::vector<SessionEvent> events;
+	size_t next = 0;
+	double replay_speed = 1.0;
+	Clock::time_point started;
+};
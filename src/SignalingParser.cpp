@@ -0,0 +1,513 @@
+#include "SignalingParser.h"
+
+namespace
+{
+	// Minimal in-situ JSON reader for the signaling schema. Unknown keys are
+	// skipped (but still validated); anything that is not valid JSON per
+	// RFC 8259, including unpaired surrogates, makes the whole parse fail.
+	class Reader
+	{
+	public:
+		explicit Reader(std::string &buffer) : buf(buffer.data()), end(buffer.data() + buffer.size()) {}
+
+		bool parseMessage(SignalingMessage &out)
+		{
+			if (!expect('{'))
+			{
+				return false;
+			}
+			if (consume('}'))
+			{
+				return false;
+			}
+
+			do
+			{
+				std::string_view key;
+				if (!readString(key) || !expect(':'))
+				{
+					return false;
+				}
+
+				bool ok;
+				if (key == "type")
+				{
+					ok = readString(out.type_name);
+				}
+				else if (key == "from")
+				{
+					ok = readNullableString(out.from);
+				}
+				else if (key == "to")
+				{
+					ok = readNullableString(out.to);
+				}
+				else if (key == "data")
+				{
+					ok = readData(out);
+				}
+				else
+				{
+					ok = skipValue();
+				}
+
+				if (!ok)
+				{
+					return false;
+				}
+			} while (consume(','));
+
+			if (!expect('}'))
+			{
+				return false;
+			}
+
+			skipWhitespace();
+			if (pos != end || out.type_name.empty())
+			{
+				return false;
+			}
+
+			out.type = lookupSignalingType(out.type_name);
+			return hasRequiredFields(out);
+		}
+
+	private:
+		char *buf;
+		char *end;
+		char *pos = buf;
+
+		// Everything the handler reads for this type is present. Descriptions and
+		// candidates need their sender and a string payload (the SDP or the candidate line).
+		static bool hasRequiredFields(const SignalingMessage &out)
+		{
+			switch (out.type)
+			{
+			case SignalingType::Offer:
+			case SignalingType::Answer:
+			case SignalingType::IceCandidate:
+				return !out.from.empty() && !out.data.empty();
+			case SignalingType::ConnectionRequest:
+			case SignalingType::ConnectionResponse:
+				return !out.from.empty();
+			default:
+				return true;
+			}
+		}
+
+		void skipWhitespace()
+		{
+			while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+			{
+				pos++;
+			}
+		}
+
+		bool consume(char c)
+		{
+			skipWhitespace();
+			if (pos < end && *pos == c)
+			{
+				pos++;
+				return true;
+			}
+			return false;
+		}
+
+		bool expect(char c) { return consume(c); }
+
+		bool consumeLiteral(std::string_view literal)
+		{
+			if (static_cast<size_t>(end - pos) < literal.size() || std::string_view(pos, literal.size()) != literal)
+			{
+				return false;
+			}
+			pos += literal.size();
+			return true;
+		}
+
+		static int hexValue(char c)
+		{
+			if (c >= '0' && c <= '9')
+				return c - '0';
+			if (c >= 'a' && c <= 'f')
+				return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F')
+				return c - 'A' + 10;
+			return -1;
+		}
+
+		bool readHex4(uint32_t &value)
+		{
+			if (end - pos < 4)
+			{
+				return false;
+			}
+			value = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				int digit = hexValue(*pos++);
+				if (digit < 0)
+				{
+					return false;
+				}
+				value = (value << 4) | static_cast<uint32_t>(digit);
+			}
+			return true;
+		}
+
+		static char *writeUtf8(char *out, uint32_t cp)
+		{
+			if (cp < 0x80)
+			{
+				*out++ = static_cast<char>(cp);
+			}
+			else if (cp < 0x800)
+			{
+				*out++ = static_cast<char>(0xC0 | (cp >> 6));
+				*out++ = static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000)
+			{
+				*out++ = static_cast<char>(0xE0 | (cp >> 12));
+				*out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				*out++ = static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			else
+			{
+				*out++ = static_cast<char>(0xF0 | (cp >> 18));
+				*out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+				*out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				*out++ = static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			return out;
+		}
+
+		// Decodes a string literal to 'dest', which may be at or before the
+		// literal itself: escapes only ever shrink, so writes never overtake reads.
+		bool decodeStringTo(char *dest, std::string_view &value)
+		{
+			skipWhitespace();
+			if (pos >= end || *pos != '"')
+			{
+				return false;
+			}
+			pos++;
+
+			char *out = dest;
+			while (pos < end)
+			{
+				char c = *pos++;
+				if (c == '"')
+				{
+					value = std::string_view(dest, static_cast<size_t>(out - dest));
+					return true;
+				}
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					return false;
+				}
+				if (c != '\\')
+				{
+					*out++ = c;
+					continue;
+				}
+
+				if (pos >= end)
+				{
+					return false;
+				}
+				char esc = *pos++;
+				switch (esc)
+				{
+				case '"':
+				case '\\':
+				case '/':
+					*out++ = esc;
+					break;
+				case 'b':
+					*out++ = '\b';
+					break;
+				case 'f':
+					*out++ = '\f';
+					break;
+				case 'n':
+					*out++ = '\n';
+					break;
+				case 'r':
+					*out++ = '\r';
+					break;
+				case 't':
+					*out++ = '\t';
+					break;
+				case 'u':
+				{
+					uint32_t cp;
+					if (!readHex4(cp))
+					{
+						return false;
+					}
+					if (cp >= 0xDC00 && cp <= 0xDFFF)
+					{
+						return false; // Low surrogate without a high one before it
+					}
+					if (cp >= 0xD800 && cp <= 0xDBFF)
+					{
+						uint32_t low;
+						if (!consumeLiteral("\\u") || !readHex4(low) || low < 0xDC00 || low > 0xDFFF)
+						{
+							return false;
+						}
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+					}
+					out = writeUtf8(out, cp);
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return false;
+		}
+
+		bool readString(std::string_view &value)
+		{
+			skipWhitespace();
+			return decodeStringTo(pos + 1, value);
+		}
+
+		bool readNullableString(std::string_view &value)
+		{
+			skipWhitespace();
+			if (consumeLiteral("null"))
+			{
+				value = {};
+				return true;
+			}
+			return readString(value);
+		}
+
+		bool readData(SignalingMessage &out)
+		{
+			skipWhitespace();
+			if (pos < end && *pos == '"')
+			{
+				return readString(out.data);
+			}
+			if (pos < end && *pos == '{')
+			{
+				return readDataObject(out);
+			}
+			return skipValue();
+		}
+
+		bool readDataObject(SignalingMessage &out)
+		{
+			consume('{');
+			if (consume('}'))
+			{
+				return true;
+			}
+
+			do
+			{
+				std::string_view key;
+				if (!readString(key) || !expect(':'))
+				{
+					return false;
+				}
+
+				bool ok;
+				if (key == "accepted")
+				{
+					ok = readBool(out.accepted);
+					out.has_accepted = true;
+				}
+				else if (key == "clients")
+				{
+					ok = readClientArray(out);
+				}
+				else
+				{
+					ok = skipValue();
+				}
+
+				if (!ok)
+				{
+					return false;
+				}
+			} while (consume(','));
+
+			return expect('}');
+		}
+
+		bool readBool(bool &value)
+		{
+			skipWhitespace();
+			if (consumeLiteral("true"))
+			{
+				value = true;
+				return true;
+			}
+			if (consumeLiteral("false"))
+			{
+				value = false;
+				return true;
+			}
+			return false;
+		}
+
+		// Packs the decoded ids at the start of the array's own text, '\0' terminated
+		bool readClientArray(SignalingMessage &out)
+		{
+			skipWhitespace();
+			if (consumeLiteral("null"))
+			{
+				return true;
+			}
+			if (!expect('['))
+			{
+				return false;
+			}
+
+			char *packed_start = pos;
+			char *packed_end = pos;
+			if (!consume(']'))
+			{
+				do
+				{
+					std::string_view id;
+					// '\0' separates the packed ids, so an id containing one (via \u0000) would split in two
+					if (!decodeStringTo(packed_end, id) || id.find('\0') != std::string_view::npos)
+					{
+						return false;
+					}
+					packed_end += id.size();
+					*packed_end++ = '\0';
+				} while (consume(','));
+
+				if (!expect(']'))
+				{
+					return false;
+				}
+			}
+
+			out.has_clients = true;
+			out.clients = std::string_view(packed_start, static_cast<size_t>(packed_end - packed_start));
+			return true;
+		}
+
+		bool skipValue(int depth = 0)
+		{
+			if (depth > 64)
+			{
+				return false;
+			}
+
+			skipWhitespace();
+			if (pos >= end)
+			{
+				return false;
+			}
+
+			switch (*pos)
+			{
+			case '"':
+			{
+				std::string_view ignored;
+				return readString(ignored);
+			}
+			case '{':
+			case '[':
+			{
+				char close = *pos == '{' ? '}' : ']';
+				bool is_object = close == '}';
+				pos++;
+				if (consume(close))
+				{
+					return true;
+				}
+				do
+				{
+					if (is_object)
+					{
+						std::string_view key;
+						if (!readString(key) || !expect(':'))
+						{
+							return false;
+						}
+					}
+					if (!skipValue(depth + 1))
+					{
+						return false;
+					}
+				} while (consume(','));
+				return expect(close);
+			}
+			case 't':
+				return consumeLiteral("true");
+			case 'f':
+				return consumeLiteral("false");
+			case 'n':
+				return consumeLiteral("null");
+			default:
+				return skipNumber();
+			}
+		}
+
+		size_t skipDigits()
+		{
+			char *start = pos;
+			while (pos < end && *pos >= '0' && *pos <= '9')
+			{
+				pos++;
+			}
+			return static_cast<size_t>(pos - start);
+		}
+
+		// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+		bool skipNumber()
+		{
+			if (pos < end && *pos == '-')
+			{
+				pos++;
+			}
+			if (pos < end && *pos == '0')
+			{
+				pos++;
+			}
+			else if (pos >= end || *pos < '1' || *pos > '9' || skipDigits() == 0)
+			{
+				return false;
+			}
+			if (pos < end && *pos == '.')
+			{
+				pos++;
+				if (skipDigits() == 0)
+				{
+					return false;
+				}
+			}
+			if (pos < end && (*pos == 'e' || *pos == 'E'))
+			{
+				pos++;
+				if (pos < end && (*pos == '+' || *pos == '-'))
+				{
+					pos++;
+				}
+				if (skipDigits() == 0)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
+
+bool parseSignalingMessage(std::string &buffer, SignalingMessage &out)
+{
+	out = SignalingMessage{};
+	Reader reader(buffer);
+	return reader.parseMessage(out);
+}
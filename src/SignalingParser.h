@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Message types understood by the signaling protocol (see signal_server/server.go)
+enum class SignalingType : uint8_t
+{
+	Unknown,
+	Offer,
+	Answer,
+	IceCandidate,
+	ClientList,
+	ConnectionRequest,
+	ConnectionResponse,
+	Joined
+};
+
+namespace signaling_detail
+{
+	struct TypeEntry
+	{
+		std::string_view name;
+		SignalingType type;
+	};
+
+	inline constexpr TypeEntry TYPE_ENTRIES[] = {
+		{"offer", SignalingType::Offer},
+		{"answer", SignalingType::Answer},
+		{"ice-candidate", SignalingType::IceCandidate},
+		{"client-list", SignalingType::ClientList},
+		{"connection-request", SignalingType::ConnectionRequest},
+		{"connection-response", SignalingType::ConnectionResponse},
+		{"joined", SignalingType::Joined},
+	};
+
+	inline constexpr size_t TABLE_SIZE = 16;
+
+	// Perfect for the names above; checked at compile time below
+	constexpr size_t typeHash(std::string_view s)
+	{
+		if (s.empty())
+		{
+			return 0;
+		}
+		return (s.size() + static_cast<uint8_t>(s.front()) * 2 + static_cast<uint8_t>(s.back()) * 4) & (TABLE_SIZE - 1);
+	}
+
+	constexpr std::array<TypeEntry, TABLE_SIZE> buildTypeTable()
+	{
+		std::array<TypeEntry, TABLE_SIZE> table{};
+		for (const auto &entry : TYPE_ENTRIES)
+		{
+			table[typeHash(entry.name)] = entry;
+		}
+		return table;
+	}
+
+	constexpr bool typeHashIsPerfect()
+	{
+		auto table = buildTypeTable();
+		for (const auto &entry : TYPE_ENTRIES)
+		{
+			if (table[typeHash(entry.name)].type != entry.type)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static_assert(typeHashIsPerfect(), "signaling type hash collides - adjust typeHash()");
+
+	inline constexpr auto TYPE_TABLE = buildTypeTable();
+}
+
+// One hash, one compare
+constexpr SignalingType lookupSignalingType(std::string_view name)
+{
+	const auto &entry = signaling_detail::TYPE_TABLE[signaling_detail::typeHash(name)];
+	return entry.name == name && !name.empty() ? entry.type : SignalingType::Unknown;
+}
+
+// Fields of a signaling message, as views into the buffer it was parsed from.
+// Only valid while that buffer is alive and unmodified.
+struct SignalingMessage
+{
+	SignalingType type = SignalingType::Unknown;
+	std::string_view type_name;
+	std::string_view from;
+	std::string_view to;
+
+	// "data" when it is a string: the SDP of an offer/answer or an ICE candidate
+	std::string_view data;
+
+	// "data" when it is an object
+	bool accepted = false;		 // connection-response: data.accepted
+	bool has_accepted = false;	 // connection-response: data.accepted present
+	bool has_clients = false;	 // client-list: data.clients present
+	std::string_view clients;	 // client-list: ids packed back to back, each terminated by '\0'
+
+	template <typename F>
+	void forEachClient(F &&callback) const
+	{
+		size_t start = 0;
+		while (start < clients.size())
+		{
+			size_t end = clients.find('\0', start);
+			callback(clients.substr(start, end - start));
+			start = end + 1;
+		}
+	}
+};
+
+// Parses a signaling message in place. String values are unescaped into the
+// buffer itself, so no allocation happens; the returned views point into it.
+// Returns false on malformed input, a message without a "type", or one missing
+// what its type needs: a non-empty "from" on offers, answers, candidates and
+// connection requests/responses, and a non-empty string "data" on the first three.
+bool parseSignalingMessage(std::string &buffer, SignalingMessage &out);
@@ -0,0 +1,222 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace
+{
+	std::atomic<bool> g_enabled{false};
+
+	namespace
+	{
+		struct Event
+		{
+			const char *name;
+			int64_t start_us;
+			int64_t dur_us;
+		};
+
+		// Written only by its owning thread. Events go into chunks allocated on
+		// the first record that needs them, so a thread that never records while
+		// tracing costs nothing. 'count' is published with release so dump() can
+		// read [0, count) from another thread without locking.
+		struct ThreadBuffer
+		{
+			static constexpr size_t CHUNK = 4096;
+			static constexpr size_t MAX_CHUNKS = 64;
+			static constexpr size_t CAPACITY = CHUNK * MAX_CHUNKS;
+
+			std::atomic<Event *> chunks[MAX_CHUNKS] = {};
+			std::atomic<size_t> count{0};
+			std::atomic<size_t> dropped{0};
+			std::atomic<uint64_t> generation{0}; // Recording the events belong to
+			std::atomic<const char *> thread_name{nullptr};
+			std::atomic<bool> exited{false};
+			int tid = 0;
+
+			~ThreadBuffer()
+			{
+				for (auto &chunk : chunks)
+				{
+					delete[] chunk.load(std::memory_order_relaxed);
+				}
+			}
+		};
+
+		const auto s_epoch = std::chrono::steady_clock::now();
+
+		// Bumped by every setEnabled(true); each thread clears its own buffer when it sees a new one
+		std::atomic<uint64_t> s_generation{1};
+
+		std::mutex s_registry_mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> s_registry; // Buffers of exited threads go at the next recording
+		int s_next_tid = 1;
+
+		// Marks the buffer when its thread exits
+		struct ThreadSlot
+		{
+			ThreadBuffer *buffer = nullptr;
+			~ThreadSlot()
+			{
+				if (buffer)
+				{
+					buffer->exited.store(true, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		ThreadBuffer &threadBuffer()
+		{
+			thread_local ThreadSlot slot;
+			if (!slot.buffer)
+			{
+				std::lock_guard<std::mutex> lock(s_registry_mutex);
+				s_registry.push_back(std::make_unique<ThreadBuffer>());
+				s_registry.back()->tid = s_next_tid++;
+				slot.buffer = s_registry.back().get();
+			}
+			return *slot.buffer;
+		}
+
+		// Buffers holding events of the current recording
+		bool isCurrent(const ThreadBuffer &buffer)
+		{
+			return buffer.generation.load(std::memory_order_acquire) == s_generation.load(std::memory_order_relaxed);
+		}
+
+		void writeEscaped(std::ofstream &out, const char *text)
+		{
+			for (const char *c = text; *c; c++)
+			{
+				if (*c == '"' || *c == '\\')
+				{
+					out << '\\';
+				}
+				out << *c;
+			}
+		}
+	}
+
+	int64_t nowMicros()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+	}
+
+	void record(const char *name, int64_t start_us, int64_t end_us)
+	{
+		ThreadBuffer &buffer = threadBuffer();
+
+		// A new recording started: the owner clears its own counters, then publishes the generation.
+		// Acquire pairs with setEnabled, so reads by an earlier dump() finish before slots are reused.
+		uint64_t generation = s_generation.load(std::memory_order_acquire);
+		if (buffer.generation.load(std::memory_order_relaxed) != generation)
+		{
+			buffer.count.store(0, std::memory_order_relaxed);
+			buffer.dropped.store(0, std::memory_order_relaxed);
+			buffer.generation.store(generation, std::memory_order_release);
+		}
+
+		size_t index = buffer.count.load(std::memory_order_relaxed);
+		if (index >= ThreadBuffer::CAPACITY)
+		{
+			buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		std::atomic<Event *> &slot = buffer.chunks[index / ThreadBuffer::CHUNK];
+		Event *chunk = slot.load(std::memory_order_relaxed);
+		if (!chunk)
+		{
+			chunk = new Event[ThreadBuffer::CHUNK];
+			slot.store(chunk, std::memory_order_relaxed); // Published by the count store below
+		}
+		chunk[index % ThreadBuffer::CHUNK] = {name, start_us, end_us - start_us};
+		buffer.count.store(index + 1, std::memory_order_release);
+	}
+
+	void setEnabled(bool enabled)
+	{
+		if (enabled && !isEnabled())
+		{
+			// Other threads' counters are theirs to reset: they see the new generation on their next
+			// record. Zones already open keep their own start time, so at worst a zone straddling the
+			// reset is recorded into the new session.
+			std::lock_guard<std::mutex> lock(s_registry_mutex);
+			s_generation.fetch_add(1, std::memory_order_release);
+			std::erase_if(s_registry, [](const std::unique_ptr<ThreadBuffer> &buffer)
+						  { return buffer->exited.load(std::memory_order_relaxed); });
+		}
+		g_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	void setThreadName(const char *name)
+	{
+		threadBuffer().thread_name.store(name, std::memory_order_relaxed);
+	}
+
+	size_t eventCount()
+	{
+		std::lock_guard<std::mutex> lock(s_registry_mutex);
+		size_t total = 0;
+		for (const auto &buffer : s_registry)
+		{
+			if (isCurrent(*buffer))
+			{
+				total += buffer->count.load(std::memory_order_acquire);
+			}
+		}
+		return total;
+	}
+
+	size_t droppedCount()
+	{
+		std::lock_guard<std::mutex> lock(s_registry_mutex);
+		size_t total = 0;
+		for (const auto &buffer : s_registry)
+		{
+			if (isCurrent(*buffer))
+			{
+				total += buffer->dropped.load(std::memory_order_relaxed);
+			}
+		}
+		return total;
+	}
+
+	bool dump(const std::string &path)
+	{
+		std::ofstream out(path, std::ios::trunc);
+		if (!out)
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(s_registry_mutex);
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		for (const auto &buffer : s_registry)
+		{
+			if (const char *name = buffer->thread_name.load(std::memory_order_relaxed))
+			{
+				out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->tid
+					<< ",\"args\":{\"name\":\"";
+				writeEscaped(out, name);
+				out << "\"}}";
+				first = false;
+			}
+
+			size_t count = isCurrent(*buffer) ? buffer->count.load(std::memory_order_acquire) : 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				const Event &event = buffer->chunks[i / ThreadBuffer::CHUNK].load(std::memory_order_relaxed)[i % ThreadBuffer::CHUNK];
+				out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"name\":\"";
+				writeEscaped(out, event.name);
+				out << "\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << event.start_us << ",\"dur\":" << event.dur_us << "}";
+				first = false;
+			}
+		}
+		out << "\n]}\n";
+		return static_cast<bool>(out);
+	}
+}
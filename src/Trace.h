@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Lightweight scoped-zone tracer. Each thread appends complete events to its
+// own buffer, allocated in chunks as it records and capped at 256K events
+// (no locks on the hot path); dump() writes everything
+// as Chrome trace-event JSON, which chrome://tracing and ui.perfetto.dev load.
+//
+//   void App::run() { TRACE_SCOPE("Frame"); ... }
+//
+// Zone names must be string literals (only the pointer is stored).
+namespace Trace
+{
+	extern std::atomic<bool> g_enabled;
+
+	inline bool isEnabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+	// Enabling starts a fresh recording; previously recorded events are discarded
+	void setEnabled(bool enabled);
+
+	// Names the calling thread in the trace (e.g. "Main")
+	void setThreadName(const char *name);
+
+	// Writes the current recording; returns false if the file cannot be written
+	bool dump(const std::string &path);
+
+	size_t eventCount();
+	size_t droppedCount();
+
+	int64_t nowMicros();
+	void record(const char *name, int64_t start_us, int64_t end_us);
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char *zone_name) : name(isEnabled() ? zone_name : nullptr), start_us(name ? nowMicros() : 0) {}
+		~Scope()
+		{
+			if (name)
+			{
+				record(name, start_us, nowMicros());
+			}
+		}
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		const char *name;
+		int64_t start_us;
+	};
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
@@ -0,0 +1,144 @@
+#include "TransportProfile.h"
+
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+rtc::Configuration TransportProfile::toConfiguration() const
+{
+	rtc::Configuration config;
+	for (const auto &server : ice_servers)
+	{
+		config.iceServers.emplace_back(server);
+	}
+	config.bindAddress = bind_address;
+	config.portRangeBegin = port_range_begin;
+	config.portRangeEnd = port_range_end;
+	config.mtu = mtu;
+	config.maxMessageSize = max_message_size;
+	config.enableIceTcp = enable_ice_tcp;
+	config.enableIceUdpMux = enable_ice_udp_mux;
+	return config;
+}
+
+void TransportProfile::applyGlobalSettings() const
+{
+	rtc::SctpSettings settings;
+	settings.sendBufferSize = sctp_send_buffer;
+	settings.recvBufferSize = sctp_recv_buffer;
+	settings.initialCongestionWindow = sctp_initial_congestion_window;
+	settings.delayedSackTime = sctp_delayed_sack_time;
+	rtc::SetSctpSettings(settings);
+}
+
+std::optional<TransportProfile> TransportProfile::builtin(const std::string &name)
+{
+	TransportProfile profile;
+	profile.name = name;
+
+	// Every peer connection shares one UDP port instead of binding its own
+	profile.enable_ice_udp_mux = true;
+
+	if (name == "lan")
+	{
+		// Host candidates only: gathering completes as soon as local interfaces are enumerated
+		profile.mtu = 1400;
+	}
+	else if (name == "wan")
+	{
+		profile.ice_servers = {"stun:stun.l.google.com:19302"};
+	}
+	else if (name == "throughput")
+	{
+		profile.ice_servers = {"stun:stun.l.google.com:19302"};
+		profile.mtu = 1400;
+		profile.max_message_size = 1024 * 1024;
+		profile.sctp_send_buffer = 8 * 1024 * 1024;
+		profile.sctp_recv_buffer = 8 * 1024 * 1024;
+		profile.sctp_initial_congestion_window = 32;
+		profile.sctp_delayed_sack_time = std::chrono::milliseconds(20);
+	}
+	else
+	{
+		return std::nullopt;
+	}
+	return profile;
+}
+
+static void applyOverrides(TransportProfile &profile, const json &fields)
+{
+	if (fields.contains("ice_servers"))
+		profile.ice_servers = fields["ice_servers"].get<std::vector<std::string>>();
+	if (fields.contains("bind_address"))
+		profile.bind_address = fields["bind_address"].get<std::string>();
+	if (fields.contains("port_range"))
+	{
+		// get<uint16_t> would wrap 70000 around to 4464, so check the full values first
+		const json &range = fields["port_range"];
+		if (!range.is_array() || range.size() != 2 || !range[0].is_number_unsigned() || !range[1].is_number_unsigned() ||
+			range[0].get<uint64_t>() == 0 || range[1].get<uint64_t>() > 65535 || range[0].get<uint64_t>() > range[1].get<uint64_t>())
+		{
+			throw std::runtime_error("Invalid port_range " + range.dump() + " for " + profile.name +
+									 ": expected [first, last] with 1 <= first <= last <= 65535");
+		}
+		profile.port_range_begin = range[0].get<uint16_t>();
+		profile.port_range_end = range[1].get<uint16_t>();
+	}
+	if (fields.contains("mtu"))
+		profile.mtu = fields["mtu"].get<size_t>();
+	if (fields.contains("max_message_size"))
+		profile.max_message_size = fields["max_message_size"].get<size_t>();
+	if (fields.contains("enable_ice_tcp"))
+		profile.enable_ice_tcp = fields["enable_ice_tcp"].get<bool>();
+	if (fields.contains("enable_ice_udp_mux"))
+		profile.enable_ice_udp_mux = fields["enable_ice_udp_mux"].get<bool>();
+	if (fields.contains("sctp_send_buffer"))
+		profile.sctp_send_buffer = fields["sctp_send_buffer"].get<size_t>();
+	if (fields.contains("sctp_recv_buffer"))
+		profile.sctp_recv_buffer = fields["sctp_recv_buffer"].get<size_t>();
+	if (fields.contains("sctp_initial_congestion_window"))
+		profile.sctp_initial_congestion_window = fields["sctp_initial_congestion_window"].get<size_t>();
+	if (fields.contains("sctp_delayed_sack_ms"))
+		profile.sctp_delayed_sack_time = std::chrono::milliseconds(fields["sctp_delayed_sack_ms"].get<int>());
+}
+
+std::optional<TransportProfile> TransportProfile::load(const std::string &name, const std::string &config_path)
+{
+	if (config_path.empty())
+	{
+		return builtin(name);
+	}
+
+	std::ifstream file(config_path);
+	if (!file)
+	{
+		throw std::runtime_error("Cannot open transport config " + config_path);
+	}
+
+	try
+	{
+		json config = json::parse(file);
+		if (!config.contains("profiles") || !config["profiles"].contains(name))
+		{
+			return builtin(name);
+		}
+
+		const json &fields = config["profiles"][name];
+		std::string base = fields.value("base", builtin(name) ? name : std::string("wan"));
+		auto profile = builtin(base);
+		if (!profile)
+		{
+			throw std::runtime_error("Unknown base profile '" + base + "' for " + name);
+		}
+
+		profile->name = name;
+		applyOverrides(*profile, fields);
+		return profile;
+	}
+	catch (const json::exception &e)
+	{
+		throw std::runtime_error("Invalid transport config " + config_path + ": " + e.what());
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "rtc/rtc.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Named set of transport settings applied to every rtc::PeerConnection.
+//
+// Built-in profiles (all multiplex ICE over a single UDP port):
+//   lan        - host candidates only (no STUN), larger MTU; nothing waits on an unreachable server
+//   wan        - public STUN server, otherwise library defaults (the default profile)
+//   throughput - like wan, with large SCTP buffers and max message size for bulk transfers
+//
+// A JSON config file can override fields or define new profiles:
+//   { "profiles": { "lab": { "base": "lan", "port_range": [40000, 40100], "mtu": 1450 } } }
+struct TransportProfile
+{
+	std::string name = "wan";
+
+	// Per-connection settings (rtc::Configuration)
+	std::vector<std::string> ice_servers;
+	std::optional<std::string> bind_address;
+	uint16_t port_range_begin = 1024;
+	uint16_t port_range_end = 65535;
+	std::optional<size_t> mtu;
+	std::optional<size_t> max_message_size;
+	bool enable_ice_tcp = false;
+	bool enable_ice_udp_mux = false;
+
+	// Process-wide SCTP settings (rtc::SetSctpSettings), applied before the first connection
+	std::optional<size_t> sctp_send_buffer;
+	std::optional<size_t> sctp_recv_buffer;
+	std::optional<size_t> sctp_initial_congestion_window;
+	std::optional<std::chrono::milliseconds> sctp_delayed_sack_time;
+
+	rtc::Configuration toConfiguration() const;
+	void applyGlobalSettings() const;
+
+	// Returns std::nullopt for an unknown name
+	static std::optional<TransportProfile> builtin(const std::string &name);
+
+	// Looks up 'name' in the file's "profiles" first, then falls back to the built-ins.
+	// Throws std::runtime_error if the file cannot be read or parsed, or a value is out of range.
+	static std::optional<TransportProfile> load(const std::string &name, const std::string &config_path = "");
+};
@@ -1,8 +1,137 @@
 #include "App.h"
 
-int main()
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+static void printUsage(const char *program)
+{
+	std::cout << "Usage: " << program << " [--transport lan|wan|throughput|<name>] [--transport-config <file.json>]\n"
+			  << "       [--impair loss=0.05,delay=40,jitter=10,reorder=0.01,rate=2000,queue=262144,seed=1]\n"
+			  << "       [--auto-accept manual|known|all|none] [--max-handshakes <n>]\n"
+			  << "       [--stream <clip.h264|clip.ogg>]... [--video-fps <fps>] [--no-mesh-signaling]\n"
+			  << "       [--record <session.bin>] [--replay <session.bin>] [--replay-speed <x, 0 = unpaced>]\n"
+			  << "       [--hibernate-after <idle seconds>] [--lan]" << std::endl;
+}
+
+int main(int argc, char **argv)
 {
-	App app;
+	AppOptions options;
+	std::string profile_name = "wan";
+	std::string profile_config;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (arg == "--transport" && i + 1 < argc)
+		{
+			profile_name = argv[++i];
+		}
+		else if (arg == "--transport-config" && i + 1 < argc)
+		{
+			profile_config = argv[++i];
+		}
+		else if (arg == "--impair" && i + 1 < argc)
+		{
+			options.impairment = ImpairmentConfig::parse(argv[++i]);
+			if (!options.impairment)
+			{
+				std::cout << "Invalid --impair spec" << std::endl;
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (arg == "--auto-accept" && i + 1 < argc)
+		{
+			auto policy = parseAutoAcceptPolicy(argv[++i]);
+			if (!policy)
+			{
+				printUsage(argv[0]);
+				return 1;
+			}
+			options.auto_accept = *policy;
+		}
+		else if (arg == "--max-handshakes" && i + 1 < argc)
+		{
+			int limit = std::atoi(argv[++i]);
+			if (limit <= 0)
+			{
+				printUsage(argv[0]);
+				return 1;
+			}
+			options.max_handshakes = static_cast<size_t>(limit);
+		}
+		else if (arg == "--stream" && i + 1 < argc)
+		{
+			options.media_files.push_back(argv[++i]);
+		}
+		else if (arg == "--video-fps" && i + 1 < argc)
+		{
+			options.video_fps = std::atof(argv[++i]);
+			if (options.video_fps <= 0.0)
+			{
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (arg == "--lan")
+		{
+			options.lan = true;
+		}
+		else if (arg == "--no-mesh-signaling")
+		{
+			options.mesh_signaling = false;
+		}
+		else if (arg == "--record" && i + 1 < argc)
+		{
+			options.record_file = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc)
+		{
+			options.replay_file = argv[++i];
+		}
+		else if (arg == "--hibernate-after" && i + 1 < argc)
+		{
+			int seconds = std::atoi(argv[++i]);
+			if (seconds < 0)
+			{
+				printUsage(argv[0]);
+				return 1;
+			}
+			options.hibernate_after = std::chrono::seconds(seconds);
+		}
+		else if (arg == "--replay-speed" && i + 1 < argc)
+		{
+			options.replay_speed = std::atof(argv[++i]);
+			if (options.replay_speed < 0.0)
+			{
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	try
+	{
+		auto profile = TransportProfile::load(profile_name, profile_config);
+		if (!profile)
+		{
+			std::cout << "Unknown transport profile '" << profile_name << "'" << std::endl;
+			return 1;
+		}
+		options.transport = *profile;
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+
+	App app(options);
 	app.run();
 	return 0;
 }
@@ -0,0 +1,73 @@
+#pragma once
+
+// Counting replacement for the global allocator, shared by the benchmarks.
+// Replaces operator new/delete for the whole program: include it from exactly
+// one translation unit per executable (the tool's main.cpp).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Calls to operator new since the program started, any form
+inline std::atomic<size_t> g_allocations{0};
+
+static void *countedAlloc(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+static void *countedAlignedAlloc(size_t size, std::align_val_t alignment)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+	void *p = _aligned_malloc(size ? size : 1, align);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	void *p = std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+#endif
+	if (p)
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+static void alignedFree(void *p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+// GCC flags the malloc/free pairing once these get inlined into library code; the pairing is correct.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void *operator new(size_t size, std::align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+void *operator new[](size_t size, std::align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { alignedFree(p); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,443 @@
+// Stress test for ReliableSession: two endpoints exchange messages over a
+// simulated link that loses and reorders frames and is torn down every few
+// hundred ticks (everything in flight is lost). Some teardowns also make one
+// side forget its session, as an explicit disconnect does; that side's app
+// sends what the old session had not confirmed again through the new one.
+//
+// Both endpoints follow the client's protocol: a resume frame on every
+// (re)connect, retransmission of everything unacked when the peer's resume
+// arrives, cumulative acks piggybacked on data or sent after ACK_EVERY/ACK_DELAY,
+// and a sender that holds a message back while enqueue() refuses it.
+//
+// Checked on every delivery and at the end:
+//   - messages arrive in order with no gap; a message arrives twice only right
+//     after a session restart (delivery across a restart is at least once)
+//   - every message sent arrives: nothing is discarded
+//   - the retransmit buffer never exceeds its message and byte budget
+//
+// Usage: delivery_stress [--ticks 200000] [--loss 0.01] [--reorder 4] [--seed 1]
+// Exits with status 1 on the first violation.
+
+#include "ReliableDelivery.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Options
+{
+	uint64_t ticks = 200000;
+	double loss = 0.01;		  // Per frame, while the link is up
+	int reorder = 4;		  // Extra random delay in ticks; frames overtake each other
+	uint32_t seed = 1;
+	int disconnect_every = 400; // Mean ticks between teardowns
+	int down_ticks = 20;
+	double forget = 0.1;	  // Share of teardowns after which one side drops its session
+	size_t max_messages = 64; // Small budget so backpressure kicks in constantly
+	size_t max_bytes = 4096;
+};
+
+struct Frame
+{
+	enum class Kind
+	{
+		Data,
+		Ack,
+		Resume
+	} kind;
+	uint64_t seq = 0;
+	uint64_t ack = 0;
+	uint64_t epoch = 0;
+	uint64_t peer_epoch = 0;
+	std::string payload;
+};
+
+struct InFlight
+{
+	uint64_t due_tick;
+	Frame frame;
+};
+
+// Payloads are the sender's message index, counting up from 0 for the whole run
+struct Endpoint
+{
+	const char *name;
+	std::unique_ptr<ReliableSession> session;
+	uint64_t next_index = 0;
+	std::string held; // Refused by enqueue, sent again next tick
+
+	// Receiving side's view of the peer's messages
+	int64_t max_index = -1; // Highest index delivered
+	int64_t cursor = -1;	// Index delivered last
+	bool rewind = false;	// Our receive state was reset: the next delivery may repeat earlier ones
+	uint64_t delivered = 0;
+	uint64_t redelivered = 0;
+
+	uint64_t refusals = 0;
+	uint64_t requeued = 0; // Unconfirmed messages the app sent again after forgetting its session
+};
+
+class Simulation
+{
+public:
+	explicit Simulation(const Options &options) : options(options), rng(options.seed)
+	{
+		a.name = "A";
+		b.name = "B";
+		a.session = newSession();
+		b.session = newSession();
+	}
+
+	bool run()
+	{
+		// Initial connect
+		connect();
+
+		std::bernoulli_distribution teardown(1.0 / options.disconnect_every);
+		std::bernoulli_distribution forget(options.forget);
+		std::bernoulli_distribution coin(0.5);
+		std::uniform_int_distribution<int> burst(0, 3);
+		uint64_t up_at = 0;
+
+		for (tick = 0; tick < options.ticks && ok; tick++)
+		{
+			if (link_up && teardown(rng))
+			{
+				disconnect();
+				if (forget(rng))
+				{
+					forgetSession(coin(rng) ? a : b);
+				}
+				up_at = tick + static_cast<uint64_t>(options.down_ticks);
+			}
+			if (!link_up && tick >= up_at)
+			{
+				connect();
+			}
+
+			for (int i = burst(rng); i > 0; i--)
+			{
+				send(a);
+			}
+			for (int i = burst(rng); i > 0; i--)
+			{
+				send(b);
+			}
+			step();
+		}
+
+		// Drain: perfect link, one last reconnect to flush anything lost, then let acks settle
+		options.loss = 0.0;
+		options.reorder = 0;
+		retryHeld(a);
+		retryHeld(b);
+		disconnect();
+		connect();
+		for (uint64_t end = tick + 10000; tick < end && ok; tick++)
+		{
+			retryHeld(a);
+			retryHeld(b);
+			step();
+			if (a.held.empty() && b.held.empty() && a.session->unacked().empty() && b.session->unacked().empty() &&
+				a_to_b.empty() && b_to_a.empty())
+			{
+				break;
+			}
+		}
+
+		if (ok)
+		{
+			checkComplete(a, b);
+			checkComplete(b, a);
+		}
+		report();
+		return ok;
+	}
+
+private:
+	std::unique_ptr<ReliableSession> newSession()
+	{
+		return std::make_unique<ReliableSession>(options.max_messages, options.max_bytes);
+	}
+
+	ReliableSession::Clock::time_point now() const
+	{
+		return base + std::chrono::milliseconds(tick);
+	}
+
+	Endpoint &peerOf(Endpoint &side) { return &side == &a ? b : a; }
+	std::vector<InFlight> &linkFrom(Endpoint &side) { return &side == &a ? a_to_b : b_to_a; }
+
+	void fail(const std::string &what)
+	{
+		if (ok)
+		{
+			std::cout << "FAIL at tick " << tick << ": " << what << std::endl;
+		}
+		ok = false;
+	}
+
+	void transmit(Endpoint &from, Frame frame)
+	{
+		if (!link_up)
+		{
+			return;
+		}
+		if (std::bernoulli_distribution(options.loss)(rng))
+		{
+			dropped++;
+			return;
+		}
+		uint64_t delay = 1 + (options.reorder > 0 ? std::uniform_int_distribution<uint64_t>(0, options.reorder)(rng) : 0);
+		linkFrom(from).push_back({tick + delay, std::move(frame)});
+	}
+
+	// Like an explicit disconnect: the session is gone. The app still has the messages
+	// it was never told had arrived and sends them again, oldest first.
+	void forgetSession(Endpoint &side)
+	{
+		auto old = std::move(side.session);
+		side.session = newSession();
+		side.rewind = true;
+		for (const auto &out : old->unacked())
+		{
+			if (side.session->enqueue(out.payload, 0) == 0)
+			{
+				fail(std::string(side.name) + " could not requeue into an empty session");
+			}
+			side.requeued++;
+		}
+	}
+
+	void send(Endpoint &side)
+	{
+		if (!side.held.empty())
+		{
+			retryHeld(side);
+			return;
+		}
+		side.held = std::to_string(side.next_index++);
+		retryHeld(side);
+	}
+
+	void retryHeld(Endpoint &side)
+	{
+		if (side.held.empty())
+		{
+			return;
+		}
+		uint64_t seq = side.session->enqueue(side.held, 0);
+		if (seq == 0)
+		{
+			side.refusals++;
+			return;
+		}
+		DeliveryStats stats = side.session->stats();
+		if (stats.buffered_messages > options.max_messages ||
+			(stats.buffered_messages > 1 && stats.buffered_bytes > options.max_bytes))
+		{
+			fail(std::string(side.name) + " buffer over budget");
+		}
+		if (side.session->isLinkReady())
+		{
+			transmit(side, {Frame::Kind::Data, seq, side.session->takeAck(), 0, 0, side.held});
+		}
+		side.held.clear();
+	}
+
+	void disconnect()
+	{
+		link_up = false;
+		a_to_b.clear();
+		b_to_a.clear();
+		a.session->setLinkReady(false);
+		b.session->setLinkReady(false);
+	}
+
+	void connect()
+	{
+		link_up = true;
+		for (Endpoint *side : {&a, &b})
+		{
+			side->session->setLinkReady(false);
+			transmit(*side, {Frame::Kind::Resume, 0, side->session->takeAck(), side->session->epoch(), side->session->peerEpoch(), {}});
+		}
+	}
+
+	void receive(Endpoint &side, const Frame &frame)
+	{
+		ReliableSession &session = *side.session;
+		Endpoint &peer = peerOf(side);
+		switch (frame.kind)
+		{
+		case Frame::Kind::Resume:
+		{
+			if (session.onResume(frame.epoch, frame.peer_epoch, frame.ack))
+			{
+				// The peer forgot us: both streams start over, ours led by what it had not acked
+				side.rewind = true;
+			}
+			for (const auto &out : session.unacked())
+			{
+				transmit(side, {Frame::Kind::Data, out.seq, session.takeAck(), 0, 0, out.payload});
+			}
+			session.markRetransmitted(session.unacked().size());
+			break;
+		}
+		case Frame::Kind::Ack:
+			session.onAck(frame.ack);
+			break;
+		case Frame::Kind::Data:
+			session.onAck(frame.ack);
+			if (session.onData(frame.seq, now()) == ReliableSession::ReceiveResult::Deliver)
+			{
+				checkDelivery(side, peer, frame.payload);
+			}
+			break;
+		}
+	}
+
+	void checkDelivery(Endpoint &receiver, Endpoint &sender, const std::string &payload)
+	{
+		int64_t index = std::stoll(payload);
+		std::string where = std::string(receiver.name) + " got " + payload;
+
+		if (receiver.rewind)
+		{
+			// After a restart the stream resumes at the sender's oldest unconfirmed message,
+			// which may be one we already had - but never past the next new one
+			if (index > receiver.max_index + 1)
+				fail(where + ": gap after " + std::to_string(receiver.max_index) + " across a restart");
+			receiver.rewind = false;
+		}
+		else if (index != receiver.cursor + 1)
+		{
+			fail(where + (index <= receiver.cursor ? ": duplicate" : ": gap") + " after " + std::to_string(receiver.cursor));
+		}
+		if (index >= static_cast<int64_t>(sender.next_index))
+		{
+			fail(where + " before it was sent");
+		}
+		if (index <= receiver.max_index)
+		{
+			receiver.redelivered++;
+		}
+		receiver.cursor = index;
+		receiver.max_index = std::max(receiver.max_index, index);
+		receiver.delivered++;
+	}
+
+	void checkComplete(Endpoint &sender, Endpoint &receiver)
+	{
+		if (!sender.held.empty() || !sender.session->unacked().empty())
+		{
+			fail(std::string(sender.name) + " still has undelivered messages after the drain");
+			return;
+		}
+		if (receiver.max_index != static_cast<int64_t>(sender.next_index) - 1)
+		{
+			fail(std::string(receiver.name) + " is missing " + std::to_string(static_cast<int64_t>(sender.next_index) - 1 - receiver.max_index) +
+				 " of " + sender.name + "'s messages");
+		}
+	}
+
+	void step()
+	{
+		// Hand over due frames; reordering comes from the random delays
+		for (Endpoint *side : {&a, &b})
+		{
+			std::vector<InFlight> &link = linkFrom(peerOf(*side));
+			for (size_t i = 0; i < link.size() && ok;)
+			{
+				if (link[i].due_tick <= tick)
+				{
+					Frame frame = std::move(link[i].frame);
+					link.erase(link.begin() + static_cast<std::ptrdiff_t>(i));
+					receive(*side, frame);
+				}
+				else
+				{
+					i++;
+				}
+			}
+		}
+
+		// Delayed acks, as WebRTCClient::update() sends them
+		for (Endpoint *side : {&a, &b})
+		{
+			if (side->session->ackDue(now()))
+			{
+				transmit(*side, {Frame::Kind::Ack, 0, side->session->takeAck(), 0, 0, {}});
+			}
+		}
+	}
+
+	void report() const
+	{
+		for (const Endpoint *side : {&a, &b})
+		{
+			DeliveryStats stats = side->session->stats();
+			std::cout << side->name << ": sent " << side->next_index << ", delivered " << side->delivered << " (" << side->redelivered
+					  << " again after a restart), refused " << side->refusals << ", requeued after forgetting " << side->requeued
+					  << ", live session: sent " << stats.sent << ", retransmitted " << stats.retransmitted << ", carried over "
+					  << stats.carried_over << ", out of order " << stats.out_of_order << ", duplicates " << stats.duplicates << std::endl;
+		}
+		std::cout << tick << " ticks, " << dropped << " frames lost on the link" << std::endl;
+		std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+	}
+
+	Options options;
+	std::mt19937 rng;
+	Endpoint a;
+	Endpoint b;
+	std::vector<InFlight> a_to_b;
+	std::vector<InFlight> b_to_a;
+	bool link_up = false;
+	uint64_t tick = 0;
+	uint64_t dropped = 0;
+	bool ok = true;
+	ReliableSession::Clock::time_point base = ReliableSession::Clock::now();
+};
+
+static void printUsage(const char *program)
+{
+	std::cout << "Usage: " << program << " [--ticks <n>] [--loss <0..1>] [--reorder <ticks>] [--seed <n>]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		const char *value = argv[++i];
+		if (arg == "--ticks")
+			options.ticks = static_cast<uint64_t>(std::atoll(value));
+		else if (arg == "--loss")
+			options.loss = std::atof(value);
+		else if (arg == "--reorder")
+			options.reorder = std::atoi(value);
+		else if (arg == "--seed")
+			options.seed = static_cast<uint32_t>(std::atol(value));
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	Simulation simulation(options);
+	return simulation.run() ? 0 : 1;
+}
@@ -0,0 +1,528 @@
+// Connection-storm harness for HandshakeScheduler: a room of simulated peers
+// that all run connectToAll at once, on a virtual clock.
+//
+// Every peer owns a real HandshakeScheduler and polls it once per UI frame.
+// Requests and responses cross a signaling server with a random one-way
+// latency. An accepted request becomes a peer connection whose DTLS setup
+// costs CPU on both peers (one core each, handshakes queue behind each other)
+// plus the ICE/DTLS round trips. Scheduler timeouts abort half-open connections
+// the way WebRTCClient does.
+//
+// With --mesh 1 signaling is routed like WebRTCClient::sendSignal with mesh
+// signaling on: through a connected neighbor that advertised a link to the
+// target ("neighbors" frames, sent once per frame when a peer's links change),
+// and through the server only when no neighbor can reach the target.
+//
+// Usage: handshake_storm [--peers 200] [--max-in-flight 8] [--latency 25] [--jitter 10]
+//                        [--rtt-handshake 150] [--dtls-cpu 15] [--timeout 20]
+//                        [--join-spread 0] [--shuffle 0] [--seed 1]
+//                        [--mesh 0] [--p2p-latency 10]
+//   --join-spread ms over which peers start their connectToAll (0 = all at once)
+//   --shuffle     1 = each peer requests in its own random order (default: roster order)
+//   --latency     one-way sender -> server -> receiver; --p2p-latency is one data-channel hop
+// Exits with status 1 unless every pair ends up connected.
+
+#include "HandshakeScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using Clock = HandshakeScheduler::Clock;
+
+struct Options
+{
+	size_t peers = 200;
+	size_t max_in_flight = 8;
+	double latency_ms = 25.0;	  // Signaling one-way latency through the server
+	double jitter_ms = 10.0;	  // Uniform +/- on every signaling message
+	double rtt_handshake_ms = 150.0; // ICE checks + DTLS round trips once both descriptions are set
+	double dtls_cpu_ms = 15.0;	  // CPU per handshake on each side, one core per peer
+	double timeout_s = 20.0;
+	double frame_ms = 16.0;		  // update() cadence, when the scheduler is polled
+	double join_spread_ms = 0.0;
+	bool shuffle = false;
+	uint32_t seed = 1;
+	double horizon_s = 600.0; // Give up after this much simulated time
+	bool mesh = false;
+	double p2p_latency_ms = 10.0; // One data-channel hop, same relative jitter as the server path
+};
+
+// Candidates each side trickles per connection
+static constexpr int CANDIDATES_PER_SIDE = 4;
+
+// Bytes of the JSON WebRTCClient sends for a data-channel-only connection
+// with 9-character ids (SDP as in signaling_loadgen)
+static constexpr size_t REQUEST_BYTES = 75;
+static constexpr size_t RESPONSE_BYTES = 91;
+static constexpr size_t DESCRIPTION_BYTES = 541;
+static constexpr size_t CANDIDATE_BYTES = 128;
+static constexpr size_t RELAY_OVERHEAD = 43;  // {"type":"relay","to":"...","signal":...}
+static constexpr size_t SIGNAL_OVERHEAD = 27; // {"type":"signal","signal":...}, the neighbor's forward
+static constexpr size_t NEIGHBORS_BASE = 31;	 // {"type":"neighbors","peers":[]}
+static constexpr size_t NEIGHBORS_PER_PEER = 12;
+
+static Clock::duration ms(double value)
+{
+	return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(value));
+}
+
+static double toMs(Clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+class Storm
+{
+public:
+	explicit Storm(const Options &options) : options(options), rng(options.seed)
+	{
+		for (size_t i = 0; i < options.peers; i++)
+		{
+			// Zero-padded so string order matches index order
+			char id[32];
+			std::snprintf(id, sizeof(id), "peer_%04zu", i);
+			ids.emplace_back(id);
+		}
+		schedulers.reserve(options.peers);
+		for (size_t i = 0; i < options.peers; i++)
+		{
+			auto &scheduler = schedulers.emplace_back(options.max_in_flight, ms(options.timeout_s * 1000.0));
+			scheduler.setLocalId(ids[i]);
+			scheduler.setPolicy(AutoAcceptPolicy::AcceptAll);
+		}
+		cpu_free.assign(options.peers, start);
+		links.resize(options.peers);
+		views.assign(options.peers, std::vector<std::vector<char>>(options.mesh ? options.peers : 0));
+		links_changed.assign(options.peers, false);
+	}
+
+	bool run()
+	{
+		std::uniform_real_distribution<double> phase(0.0, options.frame_ms);
+		std::uniform_real_distribution<double> join(0.0, options.join_spread_ms);
+		for (size_t i = 0; i < options.peers; i++)
+		{
+			schedule(start + ms(phase(rng)), [this, i]() { poll(i); }, false);
+			schedule(start + ms(options.join_spread_ms > 0.0 ? join(rng) : 0.0), [this, i]() { connectToAll(i); });
+		}
+
+		Clock::time_point horizon = start + ms(options.horizon_s * 1000.0);
+		while (!events.empty() && now < horizon)
+		{
+			Event event = events.top();
+			events.pop();
+			now = event.at;
+			if (event.counted)
+			{
+				live_events--;
+			}
+			event.action();
+
+			// Only the frame ticks are left and nobody has work queued: done
+			if (live_events == 0 && joined == options.peers && idle())
+			{
+				break;
+			}
+		}
+		return connected.size() == options.peers * (options.peers - 1) / 2;
+	}
+
+	void report() const
+	{
+		HandshakeStats total;
+		LatencyHistogram queue_wait, handshake_time;
+		size_t peak = 0;
+		for (const auto &scheduler : schedulers)
+		{
+			HandshakeStats stats = scheduler.stats();
+			total.started += stats.started;
+			total.completed += stats.completed;
+			total.failed += stats.failed;
+			total.timed_out += stats.timed_out;
+			total.rejected += stats.rejected;
+			total.glare += stats.glare;
+			peak = std::max(peak, stats.peak_in_flight);
+			merge(queue_wait, stats.queue_wait);
+			merge(handshake_time, stats.handshake_time);
+		}
+
+		size_t pairs = options.peers * (options.peers - 1) / 2;
+		std::printf("%zu peers, %zu pairs, max %zu handshakes in flight per peer, signaling %.0f +/- %.0f ms, "
+					"handshake %.0f ms + %.0f ms CPU per side\n",
+					options.peers, pairs, options.max_in_flight, options.latency_ms, options.jitter_ms,
+					options.rtt_handshake_ms, options.dtls_cpu_ms);
+		std::printf("  connected pairs      %zu / %zu (%.1f%%)\n", connected.size(), pairs,
+					100.0 * static_cast<double>(connected.size()) / static_cast<double>(pairs));
+		std::printf("  full mesh after      %.2f s (simulated)\n", toMs(last_connect - start) / 1000.0);
+		std::printf("  handshakes           %llu started, %llu completed, %llu failed, %llu timed out (%.1f%% completed)\n",
+					(unsigned long long)total.started, (unsigned long long)total.completed, (unsigned long long)total.failed,
+					(unsigned long long)total.timed_out, total.completionRate() * 100.0);
+		std::printf("  simultaneous connects %llu seen by a scheduler, %zu duplicate offers, %zu aborted connections\n",
+					(unsigned long long)total.glare, duplicate_offers, aborted);
+		std::printf("  peak in flight       %zu per peer\n", peak);
+		std::printf("  queue wait           p50 %.0f ms, p99 %.0f ms\n", queue_wait.percentile(50), queue_wait.percentile(99));
+		std::printf("  handshake time       p50 %.0f ms, p99 %.0f ms\n", handshake_time.percentile(50), handshake_time.percentile(99));
+		std::printf("  request -> answer    p50 %.0f ms, p99 %.0f ms\n", percentile(signaling_ms, 50), percentile(signaling_ms, 99));
+		std::printf("  signaling server     %zu messages, %.1f KB\n", server_messages, static_cast<double>(server_bytes) / 1024.0);
+		if (options.mesh)
+		{
+			std::printf("  mesh signaling       %zu relayed (%zu hops), %.1f KB, plus %zu neighbor lists, %.1f KB\n",
+						relayed_messages, mesh_hops, static_cast<double>(mesh_bytes) / 1024.0, neighbor_frames,
+						static_cast<double>(neighbor_bytes) / 1024.0);
+		}
+	}
+
+private:
+	struct Event
+	{
+		Clock::time_point at;
+		uint64_t order;
+		std::function<void()> action;
+		bool counted;
+
+		bool operator>(const Event &other) const { return at != other.at ? at > other.at : order > other.order; }
+	};
+
+	// One peer connection between a pair, from accepted request to connected or aborted
+	struct Attempt
+	{
+		bool aborted = false;
+	};
+
+	using Pair = std::pair<size_t, size_t>;
+
+	static Pair key(size_t a, size_t b) { return a < b ? Pair{a, b} : Pair{b, a}; }
+
+	static double percentile(std::vector<double> values, double p)
+	{
+		if (values.empty())
+		{
+			return -1.0;
+		}
+		size_t index = static_cast<size_t>(p / 100.0 * static_cast<double>(values.size() - 1) + 0.5);
+		std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+		return values[index];
+	}
+
+	static void merge(LatencyHistogram &into, const LatencyHistogram &from)
+	{
+		for (int bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++)
+		{
+			for (uint64_t n = 0; n < from.buckets()[bucket]; n++)
+			{
+				into.add(LatencyHistogram::bucketUpperMs(bucket));
+			}
+		}
+	}
+
+	// 'counted' events are real work; frame ticks are not and never run out
+	void schedule(Clock::time_point at, std::function<void()> action, bool counted = true)
+	{
+		events.push({at, next_order++, std::move(action), counted});
+		if (counted)
+		{
+			live_events++;
+		}
+	}
+
+	Clock::duration delay(double latency_ms)
+	{
+		// Jitter scales with the path so a hop keeps the server path's relative spread
+		double spread = options.latency_ms > 0.0 ? options.jitter_ms * latency_ms / options.latency_ms : 0.0;
+		std::uniform_real_distribution<double> jitter(-spread, spread);
+		return ms(std::max(0.5, latency_ms + jitter(rng)));
+	}
+
+	// Sends a signaling message at 'at' and returns when it arrives, routed like WebRTCClient::sendSignal
+	Clock::time_point signal(size_t from, size_t to, size_t bytes, Clock::time_point at)
+	{
+		if (options.mesh)
+		{
+			for (size_t neighbor : links[from])
+			{
+				const std::vector<char> &reach = views[from][neighbor];
+				if (!reach.empty() && reach[to])
+				{
+					relayed_messages++;
+					mesh_hops += 2;
+					mesh_bytes += (bytes + RELAY_OVERHEAD) + (bytes + SIGNAL_OVERHEAD);
+					return at + delay(options.p2p_latency_ms) + delay(options.p2p_latency_ms);
+				}
+			}
+		}
+		server_messages++;
+		server_bytes += bytes;
+		return at + delay(options.latency_ms);
+	}
+
+	// A peer whose links changed tells its neighbors on its next frame
+	void advertiseLinks(size_t peer)
+	{
+		links_changed[peer] = false;
+		size_t bytes = NEIGHBORS_BASE + NEIGHBORS_PER_PEER * links[peer].size();
+		std::vector<char> reach(options.peers, 0);
+		for (size_t neighbor : links[peer])
+		{
+			reach[neighbor] = 1;
+		}
+		for (size_t neighbor : links[peer])
+		{
+			neighbor_frames++;
+			neighbor_bytes += bytes;
+			schedule(now + delay(options.p2p_latency_ms), [this, neighbor, peer, reach]() { views[neighbor][peer] = reach; });
+		}
+	}
+
+	bool idle() const
+	{
+		for (const auto &scheduler : schedulers)
+		{
+			HandshakeStats stats = scheduler.stats();
+			if (stats.in_flight || stats.queued_incoming || stats.queued_outgoing)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void connectToAll(size_t peer)
+	{
+		joined++;
+		std::vector<size_t> order;
+		for (size_t other = 0; other < options.peers; other++)
+		{
+			if (other != peer && !connected.count(key(peer, other)))
+			{
+				order.push_back(other);
+			}
+		}
+		if (options.shuffle)
+		{
+			std::shuffle(order.begin(), order.end(), rng);
+		}
+		for (size_t other : order)
+		{
+			schedulers[peer].connectTo(ids[other], now);
+		}
+	}
+
+	void poll(size_t peer)
+	{
+		for (const auto &action : schedulers[peer].poll(now))
+		{
+			size_t other = index(action.peer_id);
+			switch (action.kind)
+			{
+			case HandshakeScheduler::Action::Kind::SendRequest:
+				requested[{peer, other}] = now;
+				schedule(signal(peer, other, REQUEST_BYTES, now), [this, peer, other]()
+						 { schedulers[other].onIncomingRequest(ids[peer], ids[peer], false, now); });
+				break;
+			case HandshakeScheduler::Action::Kind::Accept:
+			case HandshakeScheduler::Action::Kind::Reject:
+			{
+				bool accepted = action.kind == HandshakeScheduler::Action::Kind::Accept;
+				schedule(signal(peer, other, RESPONSE_BYTES, now), [this, peer, other, accepted]() { onResponse(other, peer, accepted); });
+				break;
+			}
+			case HandshakeScheduler::Action::Kind::Abort:
+			{
+				// WebRTCClient closes the half-open connection; the peer's side fails with it
+				auto it = attempts.find(key(peer, other));
+				if (it != attempts.end() && !it->second.aborted)
+				{
+					it->second.aborted = true;
+					aborted++;
+				}
+				break;
+			}
+			}
+		}
+		if (options.mesh && links_changed[peer])
+		{
+			advertiseLinks(peer);
+		}
+		schedule(now + ms(options.frame_ms), [this, peer]() { poll(peer); }, false);
+	}
+
+	// 'requester' hears back from 'responder'
+	void onResponse(size_t requester, size_t responder, bool accepted)
+	{
+		if (!accepted)
+		{
+			schedulers[requester].onFailed(ids[responder], now);
+			return;
+		}
+
+		// WebRTCClient creates the offer for every acceptance it receives
+		Pair pair = key(requester, responder);
+		if (connected.count(pair) || (attempts.count(pair) && !attempts[pair].aborted))
+		{
+			duplicate_offers++;
+			return;
+		}
+		attempts[pair] = Attempt{};
+
+		// Offer, answer and trickled candidates; the answer leaves once the offer is in
+		Clock::time_point offered = signal(requester, responder, DESCRIPTION_BYTES, now);
+		Clock::time_point answered = signal(responder, requester, DESCRIPTION_BYTES, offered);
+		for (int i = 0; i < CANDIDATES_PER_SIDE; i++)
+		{
+			signal(requester, responder, CANDIDATE_BYTES, now);
+			signal(responder, requester, CANDIDATE_BYTES, offered);
+		}
+		auto request = requested.find({requester, responder});
+		if (request != requested.end())
+		{
+			signaling_ms.push_back(toMs(answered - request->second));
+			requested.erase(request);
+		}
+
+		// DTLS needs a slice of each side's core; busy peers finish later
+		Clock::time_point ready = answered;
+		for (size_t side : {requester, responder})
+		{
+			Clock::time_point done = std::max(answered, cpu_free[side]) + ms(options.dtls_cpu_ms);
+			cpu_free[side] = done;
+			ready = std::max(ready, done);
+		}
+
+		schedule(ready + ms(options.rtt_handshake_ms), [this, pair]() { onHandshakeDone(pair); });
+	}
+
+	void onHandshakeDone(Pair pair)
+	{
+		Attempt attempt = attempts[pair];
+		attempts.erase(pair);
+		if (attempt.aborted)
+		{
+			schedulers[pair.first].onFailed(ids[pair.second], now);
+			schedulers[pair.second].onFailed(ids[pair.first], now);
+			return;
+		}
+		connected.insert(pair);
+		last_connect = now;
+		links[pair.first].push_back(pair.second);
+		links[pair.second].push_back(pair.first);
+		links_changed[pair.first] = true;
+		links_changed[pair.second] = true;
+		schedulers[pair.first].onConnected(ids[pair.second], now);
+		schedulers[pair.second].onConnected(ids[pair.first], now);
+	}
+
+	size_t index(const std::string &id) const
+	{
+		return static_cast<size_t>(std::atol(id.c_str() + 5));
+	}
+
+	Options options;
+	std::mt19937 rng;
+	std::vector<std::string> ids;
+	std::vector<HandshakeScheduler> schedulers;
+	std::vector<Clock::time_point> cpu_free;
+
+	Clock::time_point start{};
+	Clock::time_point now{};
+	Clock::time_point last_connect{};
+	std::priority_queue<Event, std::vector<Event>, std::greater<>> events;
+	uint64_t next_order = 0;
+	size_t live_events = 0;
+	size_t joined = 0;
+
+	std::map<Pair, Attempt> attempts;
+	std::set<Pair> connected;
+	size_t duplicate_offers = 0;
+	size_t aborted = 0;
+
+	std::map<Pair, Clock::time_point> requested; // (from, to) -> connection-request sent
+	std::vector<double> signaling_ms;			 // connection-request sent -> answer received
+	size_t server_messages = 0;
+	size_t server_bytes = 0;
+
+	// Mesh signaling: who each peer is connected to, and what it learned of its neighbors' links
+	std::vector<std::vector<size_t>> links;
+	std::vector<std::vector<std::vector<char>>> views; // views[peer][neighbor][target]
+	std::vector<bool> links_changed;
+	size_t relayed_messages = 0;
+	size_t mesh_hops = 0;
+	size_t mesh_bytes = 0;
+	size_t neighbor_frames = 0;
+	size_t neighbor_bytes = 0;
+};
+
+static void printUsage(const char *program)
+{
+	std::cout << "Usage: " << program << " [--peers <n>] [--max-in-flight <n>] [--latency <ms>] [--jitter <ms>]\n"
+			  << "       [--rtt-handshake <ms>] [--dtls-cpu <ms>] [--timeout <s>] [--join-spread <ms>]\n"
+			  << "       [--shuffle 1] [--seed <n>] [--mesh 1] [--p2p-latency <ms>]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		const char *value = argv[++i];
+		if (arg == "--peers")
+			options.peers = std::max<size_t>(2, static_cast<size_t>(std::atol(value)));
+		else if (arg == "--max-in-flight")
+			options.max_in_flight = std::max<size_t>(1, static_cast<size_t>(std::atol(value)));
+		else if (arg == "--latency")
+			options.latency_ms = std::atof(value);
+		else if (arg == "--jitter")
+			options.jitter_ms = std::atof(value);
+		else if (arg == "--rtt-handshake")
+			options.rtt_handshake_ms = std::atof(value);
+		else if (arg == "--dtls-cpu")
+			options.dtls_cpu_ms = std::atof(value);
+		else if (arg == "--timeout")
+			options.timeout_s = std::atof(value);
+		else if (arg == "--join-spread")
+			options.join_spread_ms = std::atof(value);
+		else if (arg == "--shuffle")
+			options.shuffle = std::atoi(value) != 0;
+		else if (arg == "--seed")
+			options.seed = static_cast<uint32_t>(std::atol(value));
+		else if (arg == "--mesh")
+			options.mesh = std::atoi(value) != 0;
+		else if (arg == "--p2p-latency")
+			options.p2p_latency_ms = std::atof(value);
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	// The schedulers log every glare and burst; only the report is of interest here
+	Storm storm(options);
+	std::cout.setstate(std::ios::failbit);
+	bool complete = storm.run();
+	std::cout.clear();
+	storm.report();
+	if (!complete)
+	{
+		std::printf("FAIL: not every pair connected\n");
+		return 1;
+	}
+	return 0;
+}
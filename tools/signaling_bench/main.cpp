@@ -0,0 +1,231 @@
+// Compares the old nlohmann::json DOM signaling path with the in-place parser.
+//
+// Usage: signaling_bench [corpus-file] [passes]
+//   corpus-file: one signaling message per line (e.g. captured from the
+//                "Signaling message received:" log). Without it a synthetic
+//                corpus of offers, answers, candidate bursts and roster updates is used.
+
+#include "CountingAllocator.h"
+#include "SignalingParser.h"
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+static std::string makeSdp(const std::string &type, int seed)
+{
+	std::string sdp = "v=0\r\no=rtc " + std::to_string(1000000 + seed) + " 0 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n"
+					  "a=group:BUNDLE 0\r\na=msid-semantic:WMS *\r\na=setup:" +
+					  std::string(type == "offer" ? "actpass" : "active") +
+					  "\r\na=ice-ufrag:Xk2p\r\na=ice-pwd:9Jq0fZ3yGm1nQwR8vT5uLb\r\na=ice-options:ice2,trickle\r\n"
+					  "a=fingerprint:sha-256 ";
+	for (int i = 0; i < 32; i++)
+	{
+		sdp += "A7:";
+	}
+	sdp += "00\r\nm=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\nc=IN IP4 0.0.0.0\r\na=mid:0\r\n"
+		   "a=sendrecv\r\na=sctp-port:5000\r\na=max-message-size:262144\r\n";
+	return sdp;
+}
+
+static std::vector<std::string> makeSyntheticCorpus()
+{
+	std::vector<std::string> corpus;
+	for (int peer = 0; peer < 50; peer++)
+	{
+		std::string from = "user_" + std::to_string(10000 + peer);
+		corpus.push_back(json{{"type", "connection-request"}, {"from", from}, {"to", "user_1"}, {"data", json::object()}}.dump());
+		corpus.push_back(json{{"type", "offer"}, {"from", from}, {"to", "user_1"}, {"data", makeSdp("offer", peer)}}.dump());
+		corpus.push_back(json{{"type", "answer"}, {"from", from}, {"to", "user_1"}, {"data", makeSdp("answer", peer)}}.dump());
+		for (int c = 0; c < 8; c++)
+		{
+			std::string candidate = "a=candidate:" + std::to_string(c + 1) + " 1 UDP 2122317823 192.168.1." +
+									std::to_string(peer) + " " + std::to_string(50000 + c) + " typ host";
+			corpus.push_back(json{{"type", "ice-candidate"}, {"from", from}, {"to", "user_1"}, {"data", candidate}}.dump());
+		}
+		corpus.push_back(json{{"type", "connection-response"}, {"from", from}, {"to", "user_1"}, {"data", {{"accepted", true}}}}.dump());
+
+		json clients = json::array();
+		for (int i = 0; i <= peer; i++)
+		{
+			clients.push_back("user_" + std::to_string(10000 + i));
+		}
+		corpus.push_back(json{{"type", "client-list"}, {"from", ""}, {"to", ""}, {"data", {{"clients", clients}}}}.dump());
+	}
+	return corpus;
+}
+
+// The work the original handleSignalingMessage did before touching WebRTC
+static size_t handleWithDom(const std::string &message, std::vector<std::string> &clients)
+{
+	json msg = json::parse(message);
+	std::string type = msg["type"];
+	size_t sink = 0;
+
+	if (type == "offer" || type == "answer" || type == "ice-candidate")
+	{
+		std::string from = msg["from"];
+		std::string data = msg["data"];
+		sink += from.size() + data.size();
+	}
+	else if (type == "client-list")
+	{
+		clients.clear();
+		if (msg["data"].contains("clients") && msg["data"]["clients"].is_array())
+		{
+			for (const auto &client : msg["data"]["clients"])
+			{
+				clients.push_back(client);
+			}
+		}
+		sink += clients.size();
+	}
+	else if (type == "connection-request")
+	{
+		std::string from = msg["from"];
+		sink += from.size();
+	}
+	else if (type == "connection-response")
+	{
+		std::string from = msg["from"];
+		bool accepted = msg["data"]["accepted"];
+		sink += from.size() + accepted;
+	}
+	return sink;
+}
+
+static size_t handleInPlace(std::string &buffer, std::vector<std::string_view> &clients)
+{
+	SignalingMessage msg;
+	if (!parseSignalingMessage(buffer, msg))
+	{
+		return 0;
+	}
+
+	size_t sink = 0;
+	switch (msg.type)
+	{
+	case SignalingType::Offer:
+	case SignalingType::Answer:
+	case SignalingType::IceCandidate:
+		sink += msg.from.size() + msg.data.size();
+		break;
+	case SignalingType::ClientList:
+		clients.clear();
+		msg.forEachClient([&](std::string_view client)
+						  { clients.push_back(client); });
+		sink += clients.size();
+		break;
+	case SignalingType::ConnectionRequest:
+		sink += msg.from.size();
+		break;
+	case SignalingType::ConnectionResponse:
+		sink += msg.from.size() + msg.accepted;
+		break;
+	default:
+		break;
+	}
+	return sink;
+}
+
+struct Result
+{
+	double ns_per_message;
+	double mb_per_second;
+	double allocations_per_message;
+	size_t sink;
+};
+
+template <typename F>
+static Result measure(const std::vector<std::string> &corpus, size_t corpus_bytes, int passes, F &&handle)
+{
+	size_t sink = handle(); // Warm-up pass, also sizes any reused buffers
+	size_t allocations_before = g_allocations.load();
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		sink += handle();
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	size_t allocations = g_allocations.load() - allocations_before;
+
+	double messages = static_cast<double>(corpus.size()) * passes;
+	return {
+		elapsed * 1e9 / messages,
+		static_cast<double>(corpus_bytes) * passes / elapsed / (1024.0 * 1024.0),
+		static_cast<double>(allocations) / messages,
+		sink};
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<std::string> corpus;
+	if (argc > 1)
+	{
+		std::ifstream file(argv[1]);
+		if (!file)
+		{
+			std::cerr << "Cannot open corpus " << argv[1] << std::endl;
+			return 1;
+		}
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (!line.empty())
+			{
+				corpus.push_back(line);
+			}
+		}
+	}
+	else
+	{
+		corpus = makeSyntheticCorpus();
+	}
+	int passes = argc > 2 ? std::atoi(argv[2]) : 200;
+
+	size_t corpus_bytes = 0;
+	for (const auto &message : corpus)
+	{
+		corpus_bytes += message.size();
+	}
+	std::cout << "Corpus: " << corpus.size() << " messages, " << corpus_bytes << " bytes, " << passes << " passes" << std::endl;
+
+	std::vector<std::string> dom_clients;
+	Result dom = measure(corpus, corpus_bytes, passes, [&]()
+						 {
+			size_t sink = 0;
+			for (const auto &message : corpus) {
+				sink += handleWithDom(message, dom_clients);
+			}
+			return sink; });
+
+	// The real client parses the receive buffer it owns; here each message is
+	// first copied into a reused buffer, which is included in the timing
+	std::string buffer;
+	std::vector<std::string_view> view_clients;
+	Result in_place = measure(corpus, corpus_bytes, passes, [&]()
+							  {
+			size_t sink = 0;
+			for (const auto &message : corpus) {
+				buffer.assign(message);
+				sink += handleInPlace(buffer, view_clients);
+			}
+			return sink; });
+
+	auto print = [](const char *name, const Result &r)
+	{
+		std::cout << name << ": " << r.ns_per_message << " ns/msg, " << r.mb_per_second << " MB/s, "
+				  << r.allocations_per_message << " allocs/msg" << std::endl;
+	};
+	print("nlohmann::json DOM", dom);
+	print("in-place parser   ", in_place);
+	std::cout << "Speedup: " << dom.ns_per_message / in_place.ns_per_message << "x" << std::endl;
+
+	return dom.sink == 0 || in_place.sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,591 @@
+// Load generator for the signaling server: thousands of simulated clients,
+// each on its own rtc::WebSocket, speaking the same protocol as WebRTCClient.
+//
+// Every simulated handshake runs the full message sequence
+//   connection-request -> connection-response -> offer + candidates -> answer + candidates
+// with realistic SDP sizes. Each forwarded message carries its send time, so
+// the receiver measures how long the server took to forward it.
+//
+// Usage: signaling_loadgen [--url ws://localhost:8080/ws] [--clients 1000]
+//                          [--join-rate 200] [--churn 5] [--handshakes 50]
+//                          [--candidates 4] [--duration 60] [--timeout 10]
+//   --join-rate  new connections per second while below --clients
+//   --churn      clients per second that leave (and get replaced)
+//   --handshakes simulated connection attempts per second across the room
+
+#include "LatencyProbe.h"
+#include "SignalingParser.h"
+#include "rtc/rtc.hpp"
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	std::string url = "ws://localhost:8080/ws";
+	size_t clients = 1000;
+	double join_rate = 200.0;
+	double churn = 5.0;
+	double handshakes = 50.0;
+	int candidates = 4;
+	double duration_s = 60.0;
+	double timeout_s = 10.0;
+};
+
+static int64_t nowMicros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Send time travels inside "data" (the server only forwards that field verbatim)
+static constexpr std::string_view TAG = "x-loadgen:";
+
+static std::optional<int64_t> extractTag(std::string_view raw)
+{
+	size_t pos = raw.find(TAG);
+	if (pos == std::string_view::npos)
+	{
+		return std::nullopt;
+	}
+	int64_t value = 0;
+	for (pos += TAG.size(); pos < raw.size() && raw[pos] >= '0' && raw[pos] <= '9'; pos++)
+	{
+		value = value * 10 + (raw[pos] - '0');
+	}
+	return value;
+}
+
+static std::string makeSdp(bool offer)
+{
+	std::string sdp = "v=0\r\no=rtc 4242424242 0 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\na=group:BUNDLE 0\r\n"
+					  "a=msid-semantic:WMS *\r\na=setup:" +
+					  std::string(offer ? "actpass" : "active") +
+					  "\r\na=ice-ufrag:Xk2p\r\na=ice-pwd:9Jq0fZ3yGm1nQwR8vT5uLb\r\na=ice-options:ice2,trickle\r\n"
+					  "a=fingerprint:sha-256 ";
+	for (int i = 0; i < 31; i++)
+	{
+		sdp += "A7:";
+	}
+	sdp += "00\r\nm=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\nc=IN IP4 0.0.0.0\r\na=mid:0\r\n"
+		   "a=sendrecv\r\na=sctp-port:5000\r\na=max-message-size:262144\r\n";
+	return sdp;
+}
+
+struct SimClient
+{
+	std::string id;
+	std::shared_ptr<rtc::WebSocket> ws;
+	Clock::time_point connect_started; // Join latency and timeout include the WebSocket handshake
+	std::atomic<bool> joined{false};
+	std::atomic<bool> leaving{false};
+};
+
+struct Stats
+{
+	uint64_t sent = 0;
+	uint64_t received = 0;
+	uint64_t sent_bytes = 0;
+	uint64_t received_bytes = 0;
+	uint64_t client_lists = 0; // Roster broadcasts received (join/leave fan-out)
+
+	uint64_t joins = 0;
+	uint64_t handshakes_started = 0;
+	uint64_t handshakes_completed = 0;
+
+	uint64_t send_failures = 0;
+	uint64_t socket_errors = 0;
+	uint64_t unexpected_closes = 0;
+	uint64_t join_timeouts = 0;
+	uint64_t handshake_timeouts = 0;
+
+	LatencyHistogram forward_latency; // Sender -> server -> receiver, per message
+	LatencyHistogram join_latency;	  // connect -> joined
+	LatencyHistogram handshake_latency; // connection-request -> answer received
+
+	uint64_t errors() const { return send_failures + socket_errors + unexpected_closes + join_timeouts + handshake_timeouts; }
+};
+
+class LoadGenerator
+{
+public:
+	explicit LoadGenerator(Options options) : options(std::move(options)), offer_sdp(makeSdp(true)), answer_sdp(makeSdp(false)) {}
+
+	int run();
+
+private:
+	void connectClient();
+	void dropRandomClient();
+	void startHandshake();
+	void expireTimeouts(Clock::time_point now);
+	void onMessage(const std::shared_ptr<SimClient> &client, std::string message);
+	void send(SimClient &client, const json &message);
+	void sendCandidates(SimClient &client, const std::string &to);
+	void markJoined(const std::shared_ptr<SimClient> &client);
+	void forget(const std::string &id);
+	void report(double elapsed_s, double interval_s, const Stats &previous);
+
+	Options options;
+	std::string offer_sdp;
+	std::string answer_sdp;
+	std::mt19937 rng{std::random_device{}()};
+	uint64_t next_client = 0;
+
+	std::mutex mutex; // Guards everything below; callbacks run on libdatachannel threads
+	std::unordered_map<std::string, std::shared_ptr<SimClient>> clients;
+	std::vector<std::string> joined_ids; // For random picks
+	std::unordered_map<std::string, size_t> joined_index;
+	std::unordered_map<std::string, Clock::time_point> handshakes; // "initiator|responder" -> started
+	std::vector<std::shared_ptr<SimClient>> retired;			   // Closed sockets, kept alive until exit
+	Stats stats;
+};
+
+void LoadGenerator::send(SimClient &client, const json &message)
+{
+	std::string text = message.dump();
+	bool ok = false;
+	try
+	{
+		ok = client.ws->send(text);
+	}
+	catch (const std::exception &)
+	{
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (ok)
+	{
+		stats.sent++;
+		stats.sent_bytes += text.size();
+	}
+	else
+	{
+		stats.send_failures++;
+	}
+}
+
+void LoadGenerator::sendCandidates(SimClient &client, const std::string &to)
+{
+	for (int c = 0; c < options.candidates; c++)
+	{
+		std::string candidate = "a=candidate:" + std::to_string(c + 1) + " 1 UDP 2122317823 10.0." + std::to_string(c) +
+								".1 " + std::to_string(50000 + c) + " typ host " + std::string(TAG) + std::to_string(nowMicros());
+		send(client, {{"type", "ice-candidate"}, {"from", client.id}, {"to", to}, {"data", candidate}});
+	}
+}
+
+void LoadGenerator::connectClient()
+{
+	auto client = std::make_shared<SimClient>();
+	client->id = "load_" + std::to_string(next_client++);
+	client->ws = std::make_shared<rtc::WebSocket>();
+	client->connect_started = Clock::now();
+
+	// Callbacks hold weak references: the socket belongs to the client
+	std::weak_ptr<SimClient> weak = client;
+	client->ws->onOpen([this, weak]()
+					   {
+			if (auto self = weak.lock()) {
+				send(*self, {{"type", "join"}, {"from", self->id}});
+			} });
+	client->ws->onMessage([this, weak](rtc::message_variant message)
+						  {
+			auto self = weak.lock();
+			if (self && std::holds_alternative<std::string>(message)) {
+				onMessage(self, std::move(std::get<std::string>(message)));
+			} });
+	client->ws->onError([this](std::string)
+						{
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.socket_errors++; });
+	client->ws->onClosed([this, weak]()
+						 {
+			auto self = weak.lock();
+			if (self && !self->leaving) {
+				std::lock_guard<std::mutex> lock(mutex);
+				stats.unexpected_closes++;
+				forget(self->id);
+			} });
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		clients[client->id] = client;
+	}
+
+	try
+	{
+		client->ws->open(options.url);
+	}
+	catch (const std::exception &)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.socket_errors++;
+		forget(client->id);
+	}
+}
+
+// Caller holds the mutex
+void LoadGenerator::forget(const std::string &id)
+{
+	auto it = clients.find(id);
+	if (it == clients.end())
+	{
+		return;
+	}
+	retired.push_back(it->second);
+	clients.erase(it);
+
+	auto index = joined_index.find(id);
+	if (index != joined_index.end())
+	{
+		// Swap-remove keeps random picks O(1)
+		size_t slot = index->second;
+		joined_index.erase(index);
+		if (slot + 1 != joined_ids.size())
+		{
+			joined_ids[slot] = std::move(joined_ids.back());
+			joined_index[joined_ids[slot]] = slot;
+		}
+		joined_ids.pop_back();
+	}
+}
+
+void LoadGenerator::markJoined(const std::shared_ptr<SimClient> &client)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (client->joined.exchange(true) || !clients.count(client->id))
+	{
+		return;
+	}
+	stats.joins++;
+	stats.join_latency.add(std::chrono::duration<double, std::milli>(Clock::now() - client->connect_started).count());
+	joined_index[client->id] = joined_ids.size();
+	joined_ids.push_back(client->id);
+}
+
+void LoadGenerator::dropRandomClient()
+{
+	std::shared_ptr<SimClient> victim;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (joined_ids.empty())
+		{
+			return;
+		}
+		victim = clients[joined_ids[rng() % joined_ids.size()]];
+		victim->leaving = true;
+		forget(victim->id);
+	}
+	victim->ws->close();
+}
+
+void LoadGenerator::startHandshake()
+{
+	std::shared_ptr<SimClient> initiator;
+	std::string responder;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (joined_ids.size() < 2)
+		{
+			return;
+		}
+		size_t a = rng() % joined_ids.size();
+		size_t b = rng() % (joined_ids.size() - 1);
+		if (b >= a)
+		{
+			b++;
+		}
+		initiator = clients[joined_ids[a]];
+		responder = joined_ids[b];
+		if (!handshakes.emplace(initiator->id + "|" + responder, Clock::now()).second)
+		{
+			return;
+		}
+		stats.handshakes_started++;
+	}
+
+	send(*initiator, {{"type", "connection-request"}, {"from", initiator->id}, {"to", responder}, {"data", {{"tag", std::string(TAG) + std::to_string(nowMicros())}}}});
+}
+
+void LoadGenerator::onMessage(const std::shared_ptr<SimClient> &client, std::string message)
+{
+	int64_t received_us = nowMicros();
+	std::optional<int64_t> sent_us = extractTag(message);
+	size_t size = message.size();
+
+	SignalingMessage msg;
+	if (!parseSignalingMessage(message, msg))
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.socket_errors++;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.received++;
+		stats.received_bytes += size;
+		if (sent_us)
+		{
+			stats.forward_latency.add(static_cast<double>(received_us - *sent_us) / 1000.0);
+		}
+		if (msg.type == SignalingType::ClientList)
+		{
+			stats.client_lists++;
+		}
+	}
+
+	std::string from(msg.from);
+	switch (msg.type)
+	{
+	case SignalingType::Joined:
+		markJoined(client);
+		break;
+	case SignalingType::ConnectionRequest:
+		// Simulated users always accept
+		send(*client, {{"type", "connection-response"}, {"from", client->id}, {"to", from}, {"data", {{"accepted", true}, {"tag", std::string(TAG) + std::to_string(nowMicros())}}}});
+		break;
+	case SignalingType::ConnectionResponse:
+		if (msg.accepted)
+		{
+			send(*client, {{"type", "offer"}, {"from", client->id}, {"to", from}, {"data", offer_sdp + "a=" + std::string(TAG) + std::to_string(nowMicros()) + "\r\n"}});
+			sendCandidates(*client, from);
+		}
+		break;
+	case SignalingType::Offer:
+		send(*client, {{"type", "answer"}, {"from", client->id}, {"to", from}, {"data", answer_sdp + "a=" + std::string(TAG) + std::to_string(nowMicros()) + "\r\n"}});
+		sendCandidates(*client, from);
+		break;
+	case SignalingType::Answer:
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = handshakes.find(client->id + "|" + from);
+		if (it != handshakes.end())
+		{
+			stats.handshakes_completed++;
+			stats.handshake_latency.add(std::chrono::duration<double, std::milli>(Clock::now() - it->second).count());
+			handshakes.erase(it);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void LoadGenerator::expireTimeouts(Clock::time_point now)
+{
+	auto timeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.timeout_s));
+	std::vector<std::shared_ptr<SimClient>> stuck;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto it = handshakes.begin(); it != handshakes.end();)
+		{
+			if (now - it->second >= timeout)
+			{
+				stats.handshake_timeouts++;
+				it = handshakes.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		for (const auto &[id, client] : clients)
+		{
+			if (!client->joined && now - client->connect_started >= timeout)
+			{
+				stuck.push_back(client);
+			}
+		}
+		for (const auto &client : stuck)
+		{
+			stats.join_timeouts++;
+			client->leaving = true;
+			forget(client->id);
+		}
+	}
+
+	for (const auto &client : stuck)
+	{
+		client->ws->close();
+	}
+}
+
+void LoadGenerator::report(double elapsed_s, double interval_s, const Stats &previous)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cout << std::fixed << std::setprecision(1) << "[" << std::setw(6) << elapsed_s << " s] clients " << joined_ids.size()
+			  << "/" << clients.size() << " | sent " << (stats.sent - previous.sent) / interval_s << "/s, recv "
+			  << (stats.received - previous.received) / interval_s << "/s (" << (stats.client_lists - previous.client_lists) / interval_s
+			  << " rosters/s) | forward p50 " << stats.forward_latency.percentile(50) << " ms, p99 "
+			  << stats.forward_latency.percentile(99) << " ms | handshakes " << (stats.handshakes_completed - previous.handshakes_completed) / interval_s
+			  << "/s, " << handshakes.size() << " open | errors " << stats.errors() - previous.errors() << std::endl;
+}
+
+int LoadGenerator::run()
+{
+	std::cout << "Target " << options.clients << " clients at " << options.url << ", join " << options.join_rate << "/s, churn "
+			  << options.churn << "/s, handshakes " << options.handshakes << "/s, " << options.candidates
+			  << " candidates per side, " << options.duration_s << " s" << std::endl;
+
+	const auto tick = std::chrono::milliseconds(10);
+	Clock::time_point start = Clock::now();
+	Clock::time_point last = start;
+	Clock::time_point last_report = start;
+	Stats previous;
+
+	// Fractional budgets carried over between ticks
+	double join_budget = 0.0;
+	double churn_budget = 0.0;
+	double handshake_budget = 0.0;
+
+	while (true)
+	{
+		std::this_thread::sleep_for(tick);
+		Clock::time_point now = Clock::now();
+		double dt = std::chrono::duration<double>(now - last).count();
+		double elapsed = std::chrono::duration<double>(now - start).count();
+		last = now;
+		if (elapsed >= options.duration_s)
+		{
+			break;
+		}
+
+		size_t population;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			population = clients.size();
+		}
+
+		join_budget = std::min(join_budget + options.join_rate * dt, options.join_rate);
+		while (join_budget >= 1.0 && population < options.clients)
+		{
+			connectClient();
+			population++;
+			join_budget -= 1.0;
+		}
+
+		churn_budget += options.churn * dt;
+		for (; churn_budget >= 1.0; churn_budget -= 1.0)
+		{
+			dropRandomClient();
+		}
+
+		handshake_budget += options.handshakes * dt;
+		for (; handshake_budget >= 1.0; handshake_budget -= 1.0)
+		{
+			startHandshake();
+		}
+
+		expireTimeouts(now);
+
+		double since_report = std::chrono::duration<double>(now - last_report).count();
+		if (since_report >= 1.0)
+		{
+			report(elapsed, since_report, previous);
+			std::lock_guard<std::mutex> lock(mutex);
+			previous = stats;
+			last_report = now;
+		}
+	}
+
+	// Summary before tearing the sockets down, so closes are not counted
+	Stats total;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		total = stats;
+	}
+	double seconds = options.duration_s;
+	double error_rate = total.sent ? static_cast<double>(total.errors()) / static_cast<double>(total.sent) : 0.0;
+
+	std::cout << std::fixed << std::setprecision(2) << "\n=== Summary ===\n"
+			  << "messages: " << total.sent / seconds << " sent/s, " << total.received / seconds << " received/s ("
+			  << total.client_lists << " roster broadcasts, " << total.received_bytes / seconds / 1024.0 << " KiB/s in)\n"
+			  << "forward latency: p50 " << total.forward_latency.percentile(50) << " ms, p90 " << total.forward_latency.percentile(90)
+			  << " ms, p99 " << total.forward_latency.percentile(99) << " ms, p99.9 " << total.forward_latency.percentile(99.9) << " ms ("
+			  << total.forward_latency.count() << " samples)\n"
+			  << "joins: " << total.joins << ", p50 " << total.join_latency.percentile(50) << " ms, p99 " << total.join_latency.percentile(99) << " ms\n"
+			  << "handshakes: " << total.handshakes_completed << "/" << total.handshakes_started << " completed, p50 "
+			  << total.handshake_latency.percentile(50) << " ms, p99 " << total.handshake_latency.percentile(99) << " ms\n"
+			  << "errors: " << total.errors() << " (" << error_rate * 100.0 << "% of sent) - " << total.send_failures << " send failures, "
+			  << total.socket_errors << " socket errors, " << total.unexpected_closes << " unexpected closes, " << total.join_timeouts
+			  << " join timeouts, " << total.handshake_timeouts << " handshake timeouts" << std::endl;
+
+	std::vector<std::shared_ptr<SimClient>> all;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &[id, client] : clients)
+		{
+			client->leaving = true;
+			all.push_back(client);
+		}
+	}
+	for (auto &client : all)
+	{
+		client->ws->close();
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	return 0;
+}
+
+static void printUsage(const char *program)
+{
+	std::cout << "Usage: " << program << " [--url <ws-url>] [--clients <n>] [--join-rate <per s>] [--churn <per s>]\n"
+			  << "       [--handshakes <per s>] [--candidates <n>] [--duration <s>] [--timeout <s>]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		const char *value = argv[++i];
+		if (arg == "--url")
+			options.url = value;
+		else if (arg == "--clients")
+			options.clients = static_cast<size_t>(std::atol(value));
+		else if (arg == "--join-rate")
+			options.join_rate = std::atof(value);
+		else if (arg == "--churn")
+			options.churn = std::atof(value);
+		else if (arg == "--handshakes")
+			options.handshakes = std::atof(value);
+		else if (arg == "--candidates")
+			options.candidates = std::atoi(value);
+		else if (arg == "--duration")
+			options.duration_s = std::atof(value);
+		else if (arg == "--timeout")
+			options.timeout_s = std::atof(value);
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	rtc::InitLogger(rtc::LogLevel::Warning);
+	LoadGenerator generator(options);
+	return generator.run();
+}
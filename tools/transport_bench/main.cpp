@@ -0,0 +1,386 @@
+// Gathering time and bulk data-channel throughput for each transport profile.
+//
+// Two peer connections in this process are wired to each other directly (no
+// signaling server): descriptions and candidates are handed across in the
+// callbacks. The offerer pushes a fixed payload over one reliable data channel
+// with bufferedAmount flow control and the receiver times its arrival.
+//
+// Usage: transport_bench [--profile <name>] [--config <file>] [--mb 64] [--chunk 65536]
+//                        [--runs 3] [--impair <spec>] [--timeout 30]
+//   --profile one profile, in this process. Without it every built-in profile is
+//             run in a child process of its own, because SCTP settings are process-wide
+//   --impair  route both directions through ImpairmentRelay, e.g. "delay=20,loss=0.01"
+
+#include "ImpairmentRelay.h"
+#include "TransportProfile.h"
+#include "rtc/rtc.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	std::string profile; // empty = all built-ins, one child process each
+	std::string config;
+	size_t megabytes = 64;
+	size_t chunk = 64 * 1024;
+	int runs = 3;
+	std::string impair;
+	double timeout_s = 30.0;
+};
+
+struct RunResult
+{
+	bool ok = false;
+	double gathering_ms = -1.0; // Offerer: gathering InProgress -> Complete
+	double connect_ms = -1.0;	// PeerConnection created -> data channel open
+	double transfer_ms = -1.0;	// First chunk sent -> last byte received
+	size_t chunk = 0;			// Message size actually used (capped by the negotiated maximum)
+};
+
+static double msSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// One offerer/answerer pair; both sides see the other's candidates through 'relay' when set
+class Pair
+{
+public:
+	Pair(const TransportProfile &profile, ImpairmentRelay *offer_relay, ImpairmentRelay *answer_relay)
+		: offerer(std::make_shared<rtc::PeerConnection>(profile.toConfiguration())),
+		  answerer(std::make_shared<rtc::PeerConnection>(profile.toConfiguration()))
+	{
+		// Each side's relay rewrites what it receives, like WebRTCClient does with --impair
+		wire(offerer, answerer, answer_relay);
+		wire(answerer, offerer, offer_relay);
+
+		offerer->onGatheringStateChange([this](rtc::PeerConnection::GatheringState state)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (state == rtc::PeerConnection::GatheringState::InProgress)
+			{
+				gathering_started = Clock::now();
+			}
+			else if (state == rtc::PeerConnection::GatheringState::Complete)
+			{
+				gathering_ms = std::chrono::duration<double, std::milli>(Clock::now() - gathering_started).count();
+				cv.notify_all();
+			}
+		});
+
+		answerer->onDataChannel([this](std::shared_ptr<rtc::DataChannel> channel)
+		{
+			channel->onMessage([this](rtc::message_variant data)
+			{
+				size_t size = std::holds_alternative<rtc::binary>(data) ? std::get<rtc::binary>(data).size()
+																		: std::get<std::string>(data).size();
+				std::lock_guard<std::mutex> lock(mutex);
+				received += size;
+				if (received >= expected)
+				{
+					finished = Clock::now();
+					cv.notify_all();
+				}
+			});
+			std::lock_guard<std::mutex> lock(mutex);
+			incoming = channel;
+		});
+	}
+
+	~Pair()
+	{
+		if (outgoing)
+		{
+			outgoing->close();
+		}
+		offerer->close();
+		answerer->close();
+	}
+
+	RunResult run(size_t total_bytes, size_t chunk, double timeout_s)
+	{
+		RunResult result;
+		auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout_s));
+		auto created = Clock::now();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			expected = total_bytes;
+		}
+
+		// Creating the channel starts negotiation (and gathering) on the offerer
+		outgoing = offerer->createDataChannel("bench");
+		outgoing->onOpen([this]()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			open = true;
+			cv.notify_all();
+		});
+		outgoing->onBufferedAmountLow([this]()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cv.notify_all();
+		});
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!cv.wait_until(lock, deadline, [this]() { return open; }))
+		{
+			std::cout << "  data channel did not open within " << timeout_s << " s" << std::endl;
+			return result;
+		}
+		result.connect_ms = msSince(created);
+		lock.unlock();
+
+		// Keep a few messages queued so SCTP never idles, without buffering the whole payload
+		result.chunk = std::min(chunk, outgoing->maxMessageSize());
+		const size_t high_water = result.chunk * 16;
+		const size_t low_water = result.chunk * 4;
+		outgoing->setBufferedAmountLowThreshold(low_water);
+		rtc::binary payload(result.chunk, std::byte{0x5a});
+
+		auto transfer_start = Clock::now();
+		size_t sent = 0;
+		while (sent < total_bytes)
+		{
+			if (outgoing->bufferedAmount() > high_water)
+			{
+				lock.lock();
+				if (!cv.wait_until(lock, deadline, [&]() { return outgoing->bufferedAmount() <= low_water; }))
+				{
+					std::cout << "  transfer stalled at " << sent << " of " << total_bytes << " bytes" << std::endl;
+					return result;
+				}
+				lock.unlock();
+				continue;
+			}
+			size_t size = std::min(result.chunk, total_bytes - sent);
+			payload.resize(size);
+			if (!outgoing->send(payload))
+			{
+				std::cout << "  send failed at " << sent << " bytes" << std::endl;
+				return result;
+			}
+			sent += size;
+		}
+
+		lock.lock();
+		if (!cv.wait_until(lock, deadline, [this]() { return received >= expected; }))
+		{
+			std::cout << "  received " << received << " of " << expected << " bytes before the timeout" << std::endl;
+			return result;
+		}
+		// Candidates trickle, so the channel can open before the offerer has finished gathering
+		if (!cv.wait_until(lock, deadline, [this]() { return gathering_ms >= 0.0; }))
+		{
+			std::cout << "  gathering did not complete within " << timeout_s << " s" << std::endl;
+			return result;
+		}
+		result.transfer_ms = std::chrono::duration<double, std::milli>(finished - transfer_start).count();
+		result.gathering_ms = gathering_ms;
+		result.ok = true;
+		return result;
+	}
+
+private:
+	void wire(const std::shared_ptr<rtc::PeerConnection> &from, const std::shared_ptr<rtc::PeerConnection> &to,
+			  ImpairmentRelay *relay)
+	{
+		std::weak_ptr<rtc::PeerConnection> target = to;
+		from->onLocalDescription([target, relay](rtc::Description description)
+		{
+			if (auto pc = target.lock())
+			{
+				std::string sdp(description);
+				pc->setRemoteDescription(rtc::Description(relay ? relay->rewriteSdp(sdp) : sdp, description.typeString()));
+			}
+		});
+		from->onLocalCandidate([target, relay](rtc::Candidate candidate)
+		{
+			auto pc = target.lock();
+			if (!pc)
+			{
+				return;
+			}
+			std::string line(candidate);
+			if (relay)
+			{
+				auto relayed = relay->rewriteCandidate(line);
+				if (!relayed)
+				{
+					return;
+				}
+				line = *relayed;
+			}
+			try
+			{
+				pc->addRemoteCandidate(rtc::Candidate(line));
+			}
+			catch (const std::exception &e)
+			{
+				std::cout << "  candidate rejected: " << e.what() << std::endl;
+			}
+		});
+	}
+
+	std::shared_ptr<rtc::PeerConnection> offerer;
+	std::shared_ptr<rtc::PeerConnection> answerer;
+	std::shared_ptr<rtc::DataChannel> outgoing;
+	std::shared_ptr<rtc::DataChannel> incoming; // Kept alive for the duration of the run
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool open = false;
+	size_t expected = 0;
+	size_t received = 0;
+	Clock::time_point finished;
+	Clock::time_point gathering_started;
+	double gathering_ms = -1.0;
+};
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+static int runProfile(const Options &options)
+{
+	std::optional<TransportProfile> profile;
+	try
+	{
+		profile = TransportProfile::load(options.profile, options.config);
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "Failed to load transport config: " << e.what() << std::endl;
+		return 1;
+	}
+	if (!profile)
+	{
+		std::cout << "Unknown transport profile '" << options.profile << "'" << std::endl;
+		return 1;
+	}
+	profile->applyGlobalSettings();
+
+	std::unique_ptr<ImpairmentRelay> offer_relay;
+	std::unique_ptr<ImpairmentRelay> answer_relay;
+	if (!options.impair.empty())
+	{
+		auto config = ImpairmentConfig::parse(options.impair);
+		if (!config)
+		{
+			std::cout << "Invalid impairment spec '" << options.impair << "'" << std::endl;
+			return 1;
+		}
+		offer_relay = std::make_unique<ImpairmentRelay>(*config);
+		answer_relay = std::make_unique<ImpairmentRelay>(*config);
+		if (!offer_relay->start() || !answer_relay->start())
+		{
+			std::cout << "Failed to start the impairment relay" << std::endl;
+			return 1;
+		}
+	}
+
+	const size_t total_bytes = options.megabytes * 1024 * 1024;
+	std::vector<double> gathering, connect, throughput;
+	size_t chunk = 0;
+	for (int run = 0; run < options.runs; run++)
+	{
+		// A fresh pair per run, so every run pays for gathering and the SCTP handshake
+		Pair pair(*profile, offer_relay.get(), answer_relay.get());
+		RunResult result = pair.run(total_bytes, options.chunk, options.timeout_s);
+		if (!result.ok)
+		{
+			std::cout << "Profile '" << profile->name << "' run " << run + 1 << " failed" << std::endl;
+			return 1;
+		}
+		gathering.push_back(result.gathering_ms);
+		connect.push_back(result.connect_ms);
+		throughput.push_back(static_cast<double>(total_bytes) / (1024.0 * 1024.0) / (result.transfer_ms / 1000.0));
+		chunk = result.chunk;
+	}
+
+	std::printf("%-12s gathering %8.1f ms   connect %8.1f ms   %9.1f MB/s   (%zu-byte messages, median of %d x %zu MB%s%s)\n",
+				profile->name.c_str(), median(gathering), median(connect), median(throughput), chunk, options.runs,
+				options.megabytes, options.impair.empty() ? "" : ", impaired: ", options.impair.c_str());
+	return 0;
+}
+
+static void printUsage(const char *program)
+{
+	std::cout << "Usage: " << program << " [--profile <name>] [--config <file>] [--mb <n>] [--chunk <bytes>]\n"
+			  << "       [--runs <n>] [--impair <spec>] [--timeout <s>]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		const char *value = argv[++i];
+		if (arg == "--profile")
+			options.profile = value;
+		else if (arg == "--config")
+			options.config = value;
+		else if (arg == "--mb")
+			options.megabytes = std::max<size_t>(1, static_cast<size_t>(std::atol(value)));
+		else if (arg == "--chunk")
+			options.chunk = std::max<size_t>(1, static_cast<size_t>(std::atol(value)));
+		else if (arg == "--runs")
+			options.runs = std::max(1, std::atoi(value));
+		else if (arg == "--impair")
+			options.impair = value;
+		else if (arg == "--timeout")
+			options.timeout_s = std::atof(value);
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	rtc::InitLogger(rtc::LogLevel::Warning);
+
+	if (!options.profile.empty())
+	{
+		return runProfile(options);
+	}
+
+	// SCTP settings cannot be changed once the first connection exists: one child per profile
+	std::fflush(stdout);
+	int failures = 0;
+	for (const char *name : {"lan", "wan", "throughput"})
+	{
+		std::string command = std::string("\"") + argv[0] + "\" --profile " + name + " --mb " + std::to_string(options.megabytes) +
+							  " --chunk " + std::to_string(options.chunk) + " --runs " + std::to_string(options.runs) +
+							  " --timeout " + std::to_string(options.timeout_s);
+		if (!options.config.empty())
+			command += " --config \"" + options.config + "\"";
+		if (!options.impair.empty())
+			command += " --impair \"" + options.impair + "\"";
+		if (std::system(command.c_str()) != 0)
+		{
+			failures++;
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+// Builds the "WebRTC Client" window (ClientWindow, the code App::run draws)
+// against synthetic client state, with an ImGui context that has no platform
+// or renderer backend, so UI cost can be measured on a machine without a display.
+//
+// Usage: ui_bench [--roster 10000] [--history 1000000] [--peers 500] [--frames 30]
+//                 [--collapsed 1] [--budget-ms <ms>]
+//   --collapsed 1 leaves the collapsible sections closed (default: all open)
+//   --budget-ms   exit with status 1 when the median frame costs more CPU than this
+
+#include "Client.h"
+#include "ClientWindow.h"
+#include "CountingAllocator.h"
+#include "MediaStreamer.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static std::atomic<size_t> g_imgui_allocations{0};
+
+// ImGui allocates through its own hooks, not operator new
+static void *imguiAlloc(size_t size, void *)
+{
+	g_imgui_allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size);
+}
+
+static void imguiFree(void *p, void *)
+{
+	std::free(p);
+}
+
+// Stands in for the renderer backend: accepts every font texture upload ImGui asks for
+static void updateTextures()
+{
+	for (ImTextureData *tex : ImGui::GetPlatformIO().Textures)
+	{
+		if (tex->Status == ImTextureStatus_WantCreate || tex->Status == ImTextureStatus_WantUpdates)
+		{
+			tex->SetTexID(static_cast<ImTextureID>(1));
+			tex->SetStatus(ImTextureStatus_OK);
+		}
+		else if (tex->Status == ImTextureStatus_WantDestroy)
+		{
+			tex->SetTexID(ImTextureID_Invalid);
+			tex->SetStatus(ImTextureStatus_Destroyed);
+		}
+	}
+}
+
+struct Options
+{
+	size_t roster = 10000;
+	size_t history = 1000000;
+	size_t peers = 500;
+	int frames = 30;
+	bool collapsed = false;
+	double budget_ms = 0.0; // 0 = report only
+};
+
+struct FrameSample
+{
+	double cpu_ms = 0.0;   // NewFrame + window + Render, on this thread
+	double build_ms = 0.0; // ClientWindow::draw alone
+	size_t allocations = 0;
+	size_t imgui_allocations = 0;
+	int vertices = 0;
+	int indices = 0;
+	int draw_lists = 0;
+};
+
+template <typename T, typename F>
+static double percentile(const std::vector<T> &samples, double p, F value)
+{
+	std::vector<double> values;
+	values.reserve(samples.size());
+	for (const T &sample : samples)
+	{
+		values.push_back(static_cast<double>(value(sample)));
+	}
+	std::sort(values.begin(), values.end());
+	size_t index = static_cast<size_t>(p / 100.0 * static_cast<double>(values.size() - 1) + 0.5);
+	return values[index];
+}
+
+static void printUsage(const char *program)
+{
+	std::cout << "Usage: " << program << " [--roster <n>] [--history <n>] [--peers <n>] [--frames <n>]\n"
+			  << "       [--collapsed 1] [--budget-ms <ms>]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		const char *value = argv[++i];
+		if (arg == "--roster")
+			options.roster = static_cast<size_t>(std::atol(value));
+		else if (arg == "--history")
+			options.history = static_cast<size_t>(std::atol(value));
+		else if (arg == "--peers")
+			options.peers = static_cast<size_t>(std::atol(value));
+		else if (arg == "--frames")
+			options.frames = std::max(1, std::atoi(value));
+		else if (arg == "--collapsed")
+			options.collapsed = std::atoi(value) != 0;
+		else if (arg == "--budget-ms")
+			options.budget_ms = std::atof(value);
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	WebRTCClient client("user_1");
+	auto load_start = std::chrono::steady_clock::now();
+	client.loadSyntheticState(options.roster, options.history, options.peers);
+	double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+	std::cout << "Synthetic state: " << options.roster << " roster entries, " << options.history << " history lines, "
+			  << client.getConnectedPeerIds().size() << " connected peers (" << load_ms << " ms to build)" << std::endl;
+
+	// Context only: no platform window, no GPU; ImGui's font textures are "uploaded" by updateTextures()
+	ImGui::SetAllocatorFunctions(imguiAlloc, imguiFree);
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGuiIO &io = ImGui::GetIO();
+	io.IniFilename = nullptr; // Same layout on every run
+	io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+	io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+	io.DeltaTime = 1.0f / 60.0f;
+	ImGui::StyleColorsDark();
+
+	ClientWindow window(client);
+	if (!options.collapsed)
+	{
+		window.expandSections();
+	}
+
+	// The first frames auto-fit the window and bake glyphs; they are not measured
+	const int warmup = 3;
+	std::vector<FrameSample> samples;
+	samples.reserve(static_cast<size_t>(options.frames));
+	for (int frame = 0; frame < warmup + options.frames; frame++)
+	{
+		FrameSample sample;
+		size_t allocations_before = g_allocations.load();
+		size_t imgui_allocations_before = g_imgui_allocations.load();
+		int64_t cpu_start = MediaStreamer::threadCpuMicros();
+
+		ImGui::NewFrame();
+		int64_t build_start = MediaStreamer::threadCpuMicros();
+		window.draw();
+		sample.build_ms = (MediaStreamer::threadCpuMicros() - build_start) / 1000.0;
+		ImGui::Render();
+
+		sample.cpu_ms = (MediaStreamer::threadCpuMicros() - cpu_start) / 1000.0;
+		sample.allocations = g_allocations.load() - allocations_before;
+		sample.imgui_allocations = g_imgui_allocations.load() - imgui_allocations_before;
+		ImDrawData *draw_data = ImGui::GetDrawData();
+		sample.vertices = draw_data->TotalVtxCount;
+		sample.indices = draw_data->TotalIdxCount;
+		sample.draw_lists = draw_data->CmdListsCount;
+		updateTextures();
+
+		if (frame >= warmup)
+		{
+			samples.push_back(sample);
+		}
+	}
+	ImGui::DestroyContext();
+
+	auto cpu = [](const FrameSample &s) { return s.cpu_ms; };
+	auto build = [](const FrameSample &s) { return s.build_ms; };
+	auto allocations = [](const FrameSample &s) { return s.allocations; };
+	auto imgui_allocations = [](const FrameSample &s) { return s.imgui_allocations; };
+	auto vertices = [](const FrameSample &s) { return s.vertices; };
+	auto indices = [](const FrameSample &s) { return s.indices; };
+
+	std::printf("%d frames, sections %s\n", options.frames, options.collapsed ? "collapsed" : "expanded");
+	std::printf("  %-22s %12s %12s %12s\n", "", "p50", "p90", "max");
+	std::printf("  %-22s %12.3f %12.3f %12.3f\n", "frame CPU (ms)", percentile(samples, 50, cpu), percentile(samples, 90, cpu),
+				percentile(samples, 100, cpu));
+	std::printf("  %-22s %12.3f %12.3f %12.3f\n", "  window build (ms)", percentile(samples, 50, build), percentile(samples, 90, build),
+				percentile(samples, 100, build));
+	std::printf("  %-22s %12.0f %12.0f %12.0f\n", "allocations (new)", percentile(samples, 50, allocations),
+				percentile(samples, 90, allocations), percentile(samples, 100, allocations));
+	std::printf("  %-22s %12.0f %12.0f %12.0f\n", "allocations (ImGui)", percentile(samples, 50, imgui_allocations),
+				percentile(samples, 90, imgui_allocations), percentile(samples, 100, imgui_allocations));
+	std::printf("  %-22s %12.0f %12.0f %12.0f\n", "vertices", percentile(samples, 50, vertices), percentile(samples, 90, vertices),
+				percentile(samples, 100, vertices));
+	std::printf("  %-22s %12.0f %12.0f %12.0f\n", "indices", percentile(samples, 50, indices), percentile(samples, 90, indices),
+				percentile(samples, 100, indices));
+	std::printf("  draw lists: %d\n", samples.back().draw_lists);
+
+	double median_ms = percentile(samples, 50, cpu);
+	if (options.budget_ms > 0.0 && median_ms > options.budget_ms)
+	{
+		std::printf("FAIL: median frame %.3f ms over the %.3f ms budget\n", median_ms, options.budget_ms);
+		return 1;
+	}
+	return 0;
+}